@@ -0,0 +1,368 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 12:41:09 sb"
+
+/*
+  file       FrameProcessor.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/FrameProcessor.hh>
+#include <sbutil/TiffStack.hh>
+#include <sbutil/TiffWriter.hh>
+#include <sbutil/HDF5File.hh>
+#include <sbutil/Exception.hh>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+FrameProcessor::FrameProcessor()
+  : dark(),
+    gain(),
+    dark_width(0),
+    dark_height(0),
+    gain_width(0),
+    gain_height(0),
+    rois(),
+    ring_size(8),
+    decode_threads(0),
+    batch_rows(64),
+    output(NULL)
+{}
+
+void FrameProcessor::set_dark_frame(const ImageView<uint16_t>& v){
+  dark.resize(v.get_area());
+  for(size_t y=0; y<v.get_height(); ++y){
+    std::copy(v.row(y), v.row_end(y), dark.begin() + y * v.get_width());
+  }
+  dark_width = v.get_width();
+  dark_height = v.get_height();
+}
+
+void FrameProcessor::set_dark_frame(const ImageView<float>& v){
+  dark.resize(v.get_area());
+  for(size_t y=0; y<v.get_height(); ++y){
+    std::copy(v.row(y), v.row_end(y), dark.begin() + y * v.get_width());
+  }
+  dark_width = v.get_width();
+  dark_height = v.get_height();
+}
+
+void FrameProcessor::set_flat_field(const ImageView<float>& v){
+  gain.resize(v.get_area());
+  if(gain.empty()){
+    return;
+  }
+  const double mean = image_sum(v) / v.get_area();
+  for(size_t y=0; y<v.get_height(); ++y){
+    const float* p = v.row(y);
+    float* g = &gain[y * v.get_width()];
+    for(size_t x=0; x<v.get_width(); ++x){
+      g[x] = p[x] > 0 ? static_cast<float>(mean / p[x]) : 0.0f;
+    }
+  }
+  gain_width = v.get_width();
+  gain_height = v.get_height();
+}
+
+// --------------------------------------------------------------------- pipeline
+
+namespace
+{
+  enum slot_state {SLOT_FREE, SLOT_DECODING, SLOT_DECODED, SLOT_CORRECTED};
+
+  // One entry of the frame ring. Slot s carries frames s, s + R,
+  // s + 2R, ... in this order, where R is the ring size.
+  struct slot {
+      size_t frame;
+      slot_state state;
+      std::vector<unsigned char> raw;
+      std::vector<float> corrected;
+  };
+
+  struct pipeline {
+      const TiffStack& stack;
+      const std::vector<float>& dark;
+      const std::vector<float>& gain;
+      size_t n_frames;
+      size_t width;
+      size_t height;
+      size_t bits_per_sample;
+
+      std::vector<slot> ring;
+      size_t next_decode;
+      bool failed;
+      std::string error;
+      std::mutex mutex;
+      std::condition_variable cond;
+
+      pipeline(const TiffStack& stack_,
+               const std::vector<float>& dark_,
+               const std::vector<float>& gain_,
+               size_t ring_size)
+        : stack(stack_),
+          dark(dark_),
+          gain(gain_),
+          n_frames(stack_.get_number_of_frames()),
+          width(stack_.get_width(0)),
+          height(stack_.get_height(0)),
+          bits_per_sample(stack_.get_bits_per_sample(0)),
+          ring(std::min(ring_size, n_frames)),
+          next_decode(0),
+          failed(false),
+          error(),
+          mutex(),
+          cond()
+      {
+        for(size_t s=0; s<ring.size(); ++s){
+          ring[s].frame = s;
+          ring[s].state = SLOT_FREE;
+          ring[s].raw.resize(stack.get_size(0));
+          ring[s].corrected.resize(width * height);
+        }
+      }
+
+      slot& slot_of(size_t n) {return ring[n % ring.size()];}
+
+      // Block until frame N sits in its slot in state S. Return false if
+      // the pipeline failed in the meantime. Called with MUTEX held.
+      bool wait_for(std::unique_lock<std::mutex>& lock, size_t n, slot_state s){
+        slot& sl = slot_of(n);
+        cond.wait(lock, [&]{return failed || (sl.frame == n && sl.state == s);});
+        return !failed;
+      }
+
+      void fail(const std::string& msg){
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if(!failed){
+            failed = true;
+            error = msg;
+          }
+        }
+        cond.notify_all();
+      }
+
+      void advance(slot& sl, slot_state s){
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          sl.state = s;
+        }
+        cond.notify_all();
+      }
+
+      // Body of a pipeline thread. Nothing may escape a std::thread, so
+      // every exception fails the pipeline.
+      void run(void (pipeline::*loop)()){
+        try{
+          (this->*loop)();
+        }
+        catch(Exception& e){
+          fail(e.msg);
+        }
+        catch(std::exception& e){
+          fail(e.what());
+        }
+        catch(...){
+          fail("Unknown exception.");
+        }
+      }
+
+      // Each decoding thread keeps one libtiff handle for the whole run.
+      void decode_loop(){
+        TiffStack::decoder decoder(stack);
+        while(true){
+          size_t n;
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(failed || next_decode >= n_frames){
+              return;
+            }
+            n = next_decode++;
+            if(!wait_for(lock, n, SLOT_FREE)){
+              return;
+            }
+            slot_of(n).state = SLOT_DECODING;
+          }
+          slot& sl = slot_of(n);
+          decoder.load_frame(n, &sl.raw[0]);
+          advance(sl, SLOT_DECODED);
+        }
+      }
+
+      template<typename T>
+      void correct(const T* raw, float* out){
+        const size_t area = width * height;
+        const float* d = dark.empty() ? NULL : &dark[0];
+        const float* g = gain.empty() ? NULL : &gain[0];
+        if(d && g){
+          for(size_t i=0; i<area; ++i){
+            out[i] = (raw[i] - d[i]) * g[i];
+          }
+        }
+        else if(d){
+          for(size_t i=0; i<area; ++i){
+            out[i] = raw[i] - d[i];
+          }
+        }
+        else if(g){
+          for(size_t i=0; i<area; ++i){
+            out[i] = raw[i] * g[i];
+          }
+        }
+        else{
+          for(size_t i=0; i<area; ++i){
+            out[i] = raw[i];
+          }
+        }
+      }
+
+      void correct_loop(){
+        for(size_t n=0; n<n_frames; ++n){
+          {
+            std::unique_lock<std::mutex> lock(mutex);
+            if(!wait_for(lock, n, SLOT_DECODED)){
+              return;
+            }
+          }
+          slot& sl = slot_of(n);
+          if(bits_per_sample == 16){
+            correct(reinterpret_cast<const uint16_t*>(&sl.raw[0]), &sl.corrected[0]);
+          }
+          else{
+            correct(&sl.raw[0], &sl.corrected[0]);
+          }
+          advance(sl, SLOT_CORRECTED);
+        }
+      }
+  };
+}
+
+bool FrameProcessor::process(const TiffStack& stack, HDF5::File& file,
+                             const std::string& path, const std::string& name)
+{
+  const size_t n_frames = stack.get_number_of_frames();
+  try{
+    if(n_frames == 0){
+      throw EXCEPTION("Empty stack.");
+    }
+    const size_t w = stack.get_width(0);
+    const size_t h = stack.get_height(0);
+    for(size_t n=1; n<n_frames; ++n){
+      if(stack.get_width(n) != w || stack.get_height(n) != h ||
+         stack.get_bits_per_sample(n) != stack.get_bits_per_sample(0))
+      {
+        std::ostringstream os;
+        os << "Frame " << n << " differs in format from frame 0.";
+        throw EXCEPTION(os.str());
+      }
+    }
+    if(!dark.empty() && (dark_width != w || dark_height != h)){
+      throw EXCEPTION("Dark frame does not match the frame dimensions.");
+    }
+    if(!gain.empty() && (gain_width != w || gain_height != h)){
+      throw EXCEPTION("Flat field does not match the frame dimensions.");
+    }
+    for(size_t r=0; r<rois.size(); ++r){
+      if(rois[r].x + rois[r].width > w || rois[r].y + rois[r].height > h){
+        std::ostringstream os;
+        os << "ROI " << r << " exceeds the frame dimensions.";
+        throw EXCEPTION(os.str());
+      }
+    }
+  }
+  catch(Exception& e){
+    std::cerr << "FrameProcessor::process(" << stack.get_filename() << ") : "
+              << e << std::endl;
+    return false;
+  }
+
+  pipeline p(stack, dark, gain, ring_size);
+
+  size_t n_decoders = decode_threads;
+  if(n_decoders == 0){
+    n_decoders = std::max(1u, std::thread::hardware_concurrency());
+  }
+  n_decoders = std::min(n_decoders, p.ring.size());
+
+  // Everything that throws on this thread, including starting the
+  // other threads, fails the pipeline so that they stop and are joined
+  // below.
+  std::vector<std::thread> threads;
+  try{
+    for(size_t i=0; i<n_decoders; ++i){
+      threads.push_back(std::thread(&pipeline::run, &p, &pipeline::decode_loop));
+    }
+    threads.push_back(std::thread(&pipeline::run, &p, &pipeline::correct_loop));
+
+    // Reduction stage, on this thread.
+    const size_t row_size = 1 + rois.size();
+    HDF5::AppendableDataset dataset(file, path, name,
+                                    std::vector<size_t>(1, row_size));
+    std::vector<double> batch;
+    batch.reserve(batch_rows * row_size);
+
+    size_t n = 0;
+    for(; n<n_frames; ++n){
+      {
+        std::unique_lock<std::mutex> lock(p.mutex);
+        if(!p.wait_for(lock, n, SLOT_CORRECTED)){
+          break;
+        }
+      }
+      slot& sl = p.slot_of(n);
+      const ImageView<float> v(&sl.corrected[0], p.width, p.height);
+
+      batch.push_back(image_sum(v));
+      for(size_t r=0; r<rois.size(); ++r){
+        batch.push_back(image_sum(v.roi(rois[r].x, rois[r].y,
+                                        rois[r].width, rois[r].height)));
+      }
+      if(output && !output->write_frame(v)){
+        throw EXCEPTION("Failed writing corrected frame.");
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        sl.frame += p.ring.size();
+        sl.state = SLOT_FREE;
+      }
+      p.cond.notify_all();
+
+      if(batch.size() >= batch_rows * row_size){
+        dataset.Append(batch);
+        batch.clear();
+      }
+    }
+    if(n == n_frames && !batch.empty()){
+      dataset.Append(batch);
+    }
+  }
+  catch(Exception& e){
+    p.fail(e.msg);
+  }
+  catch(std::exception& e){
+    p.fail(e.what());
+  }
+  catch(...){
+    p.fail("Unknown exception.");
+  }
+
+  for(size_t i=0; i<threads.size(); ++i){
+    threads[i].join();
+  }
+
+  if(p.failed){
+    std::cerr << "FrameProcessor::process(" << stack.get_filename() << ") : "
+              << p.error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// FrameProcessor.cc ends here
@@ -0,0 +1,111 @@
+/* -*- mode: C++ -*- */
+/* Time-stamp: "2026-10-19 12:41:09 sb" */
+
+/*
+  file       FrameProcessor.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Single-pass processing of a camera TIFF stack: decode each frame,
+  subtract a dark frame, apply a flat-field correction, sum regions of
+  interest, and append the sums as one row per frame to an HDF5
+  dataset.
+
+  The three steps run as a pipeline on different threads over a
+  bounded ring of frame buffers. Decoding uses several threads, each
+  working on a different frame. Correction runs on one thread.
+  Reduction and all HDF5 and TiffWriter calls happen on the thread
+  calling process(), since libhdf5 is usually not thread-safe.
+
+  Each output row holds the sum over the whole corrected frame,
+  followed by the sum over each region of interest in the order they
+  were added.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef FRAMEPROCESSOR_HH__FA25236A_89E0_4B62_A9F2_D68E096FE309
+#define FRAMEPROCESSOR_HH__FA25236A_89E0_4B62_A9F2_D68E096FE309
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sbutil/ImageView.hh>
+
+class TiffStack;
+class TiffWriter;
+namespace HDF5 {class File;}
+
+class FrameProcessor {
+  private:
+    // make non-copyable
+    FrameProcessor(const FrameProcessor&);
+    FrameProcessor& operator=(const FrameProcessor&);
+
+  public:
+    struct roi {
+        size_t x;
+        size_t y;
+        size_t width;
+        size_t height;
+        roi(size_t x_, size_t y_, size_t width_, size_t height_)
+          : x(x_), y(y_), width(width_), height(height_) {}
+    };
+
+    FrameProcessor();
+
+    // Subtract DARK from every frame. Copied.
+    void set_dark_frame(const ImageView<uint16_t>& dark);
+    void set_dark_frame(const ImageView<float>& dark);
+    void clear_dark_frame() {dark.clear();}
+
+    // Divide every dark-subtracted frame by FLAT normalized to unit
+    // mean. Pixels where FLAT is not positive are set to zero. Copied.
+    void set_flat_field(const ImageView<float>& flat);
+    void clear_flat_field() {gain.clear();}
+
+    void add_roi(size_t x, size_t y, size_t width, size_t height){
+      rois.push_back(roi(x, y, width, height));
+    }
+    const std::vector<roi>& get_rois() const {return rois;}
+
+    // Number of frame buffers in flight, at least 2. Default: 8.
+    void set_ring_size(size_t n) {ring_size = n < 2 ? 2 : n;}
+
+    // Number of decoding threads, 0 means one per core. Default: 0.
+    void set_decode_threads(size_t n) {decode_threads = n;}
+
+    // Number of rows collected before appending them to the dataset.
+    // Default: 64.
+    void set_batch_rows(size_t n) {batch_rows = n < 1 ? 1 : n;}
+
+    // Additionally write every corrected frame as float32 to WRITER,
+    // which must be open. NULL disables. Default: NULL.
+    void set_output(TiffWriter* writer) {output = writer;}
+
+    // Process all frames of STACK and append one row per frame to the
+    // dataset PATH/NAME in FILE, see HDF5::AppendableDataset. All
+    // frames and the correction frames must have the same
+    // dimensions. Return false and print a message to std::cerr on
+    // error.
+    bool process(const TiffStack& stack, HDF5::File& file,
+                 const std::string& path, const std::string& name);
+
+  private:
+    std::vector<float> dark;
+    std::vector<float> gain;
+    size_t dark_width;
+    size_t dark_height;
+    size_t gain_width;
+    size_t gain_height;
+    std::vector<roi> rois;
+    size_t ring_size;
+    size_t decode_threads;
+    size_t batch_rows;
+    TiffWriter* output;
+};
+
+#endif /* FRAMEPROCESSOR_HH__FA25236A_89E0_4B62_A9F2_D68E096FE309 */
+
+/* FrameProcessor.hh ends here */
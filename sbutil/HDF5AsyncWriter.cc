@@ -0,0 +1,247 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 10:12:40 sb"
+
+/*
+  file       HDF5AsyncWriter.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/HDF5AsyncWriter.hh>
+#include <sbutil/Exception.hh>
+
+#include <utility>
+
+using namespace HDF5;
+
+// ------------------------------------------------------------------------- Jobs
+
+namespace
+{
+  template<typename T>
+  class DatasetJob : public AsyncWriter::Job {
+    private:
+      std::string path;
+      std::string name;
+      std::vector<size_t> dimensions;
+      std::vector<T> data;
+      WriteOptions options;
+    public:
+      DatasetJob(const std::string& path_,
+                 const std::string& name_,
+                 const std::vector<size_t>& dimensions_,
+                 std::vector<T>&& data_,
+                 const WriteOptions& options_)
+        : path(path_),
+          name(name_),
+          dimensions(dimensions_),
+          data(std::move(data_)),
+          options(options_)
+      {}
+      void Run(File& file);
+      size_t Bytes() const {return data.size() * sizeof(T);}
+  };
+
+  template<>
+  void DatasetJob<double>::Run(File& file){
+    file.WriteDatasetDouble(path, name, dimensions, data.data(), options);
+  }
+
+  template<>
+  void DatasetJob<int>::Run(File& file){
+    file.WriteDatasetInt(path, name, dimensions, data.data(), options);
+  }
+
+  template<typename T>
+  class AppendJob : public AsyncWriter::Job {
+    private:
+      AppendableDataset& dataset;
+      std::vector<T> data;
+    public:
+      AppendJob(AppendableDataset& dataset_, std::vector<T>&& data_)
+        : dataset(dataset_),
+          data(std::move(data_))
+      {}
+      void Run(File&) {dataset.Append(data);}
+      size_t Bytes() const {return data.size() * sizeof(T);}
+  };
+
+  class FlushJob : public AsyncWriter::Job {
+    public:
+      void Run(File& file) {file.Flush();}
+      size_t Bytes() const {return 0;}
+  };
+}
+
+// ------------------------------------------------------------------ AsyncWriter
+
+AsyncWriter::AsyncWriter(File& file_, size_t max_pending_bytes_)
+  : file(file_),
+    max_pending_bytes(max_pending_bytes_),
+    pending_bytes(0),
+    jobs_queued(0),
+    jobs_done(0),
+    stop(false),
+    error(),
+    queue(),
+    mutex(),
+    cond_work(),
+    cond_done(),
+    io_thread()
+{
+  io_thread = std::thread(&AsyncWriter::Loop, this);
+}
+
+AsyncWriter::~AsyncWriter(){
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop = true;
+  }
+  cond_work.notify_all();
+  // Loop() drains the queue before returning.
+  io_thread.join();
+}
+
+void AsyncWriter::Loop(){
+  std::unique_lock<std::mutex> lock(mutex);
+  while(true){
+    cond_work.wait(lock, [this]{return stop || !queue.empty();});
+    if(queue.empty()){ // stop requested and nothing left to do
+      break;
+    }
+
+    Job* job = queue.front();
+    queue.pop_front();
+    const size_t bytes = job->Bytes();
+
+    lock.unlock();
+    std::exception_ptr e;
+    try{
+      job->Run(file);
+    }
+    catch(...){
+      e = std::current_exception();
+    }
+    delete job;
+    lock.lock();
+
+    if(e && !error){
+      error = e;
+    }
+    pending_bytes -= bytes;
+    ++jobs_done;
+    cond_done.notify_all();
+  }
+}
+
+void AsyncWriter::RethrowError(){
+  // called with mutex held
+  if(error){
+    std::exception_ptr e = error;
+    error = std::exception_ptr();
+    std::rethrow_exception(e);
+  }
+}
+
+unsigned long long AsyncWriter::Push(Job* job){
+  if(!job){
+    throw EXCEPTION("AsyncWriter::Push: job is NULL.");
+  }
+  const size_t bytes = job->Bytes();
+
+  std::unique_lock<std::mutex> lock(mutex);
+  // Backpressure. Always admit a job into an empty queue, even if it
+  // alone exceeds the limit.
+  cond_done.wait(lock, [this, bytes]{
+      return error || pending_bytes == 0 ||
+        pending_bytes + bytes <= max_pending_bytes;
+    });
+  if(error){
+    delete job;
+    RethrowError();
+  }
+
+  queue.push_back(job);
+  pending_bytes += bytes;
+  const unsigned long long ticket = ++jobs_queued;
+  lock.unlock();
+  cond_work.notify_one();
+  return ticket;
+}
+
+void AsyncWriter::Flush(){
+  // Wait for our own FlushJob only, not for jobs other producers
+  // queue after it.
+  const unsigned long long ticket = Push(new FlushJob);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cond_done.wait(lock, [this, ticket]{return jobs_done >= ticket;});
+  RethrowError();
+}
+
+size_t AsyncWriter::GetPendingBytes(){
+  std::lock_guard<std::mutex> lock(mutex);
+  return pending_bytes;
+}
+
+void AsyncWriter::WriteDatasetDouble(const std::string& path,
+                                     const std::string& name,
+                                     const std::vector<size_t>& dimensions,
+                                     std::vector<double>&& data)
+{
+  WriteDatasetDouble(path, name, dimensions, std::move(data),
+                     file.GetWriteOptions());
+}
+
+void AsyncWriter::WriteDatasetDouble(const std::string& path,
+                                     const std::string& name,
+                                     const std::vector<size_t>& dimensions,
+                                     std::vector<double>&& data,
+                                     const WriteOptions& options)
+{
+  Push(new DatasetJob<double>(path, name, dimensions, std::move(data), options));
+}
+
+void AsyncWriter::WriteDatasetInt(const std::string& path,
+                                  const std::string& name,
+                                  const std::vector<size_t>& dimensions,
+                                  std::vector<int>&& data)
+{
+  WriteDatasetInt(path, name, dimensions, std::move(data),
+                  file.GetWriteOptions());
+}
+
+void AsyncWriter::WriteDatasetInt(const std::string& path,
+                                  const std::string& name,
+                                  const std::vector<size_t>& dimensions,
+                                  std::vector<int>&& data,
+                                  const WriteOptions& options)
+{
+  Push(new DatasetJob<int>(path, name, dimensions, std::move(data), options));
+}
+
+void AsyncWriter::WriteVectorDouble(const std::string& path,
+                                    const std::string& name,
+                                    std::vector<double>&& data)
+{
+  std::vector<size_t> dim(1, data.size());
+  WriteDatasetDouble(path, name, dim, std::move(data));
+}
+
+void AsyncWriter::WriteVectorInt(const std::string& path,
+                                 const std::string& name,
+                                 std::vector<int>&& data)
+{
+  std::vector<size_t> dim(1, data.size());
+  WriteDatasetInt(path, name, dim, std::move(data));
+}
+
+void AsyncWriter::Append(AppendableDataset& dataset, std::vector<double>&& data){
+  Push(new AppendJob<double>(dataset, std::move(data)));
+}
+
+void AsyncWriter::Append(AppendableDataset& dataset, std::vector<int>&& data){
+  Push(new AppendJob<int>(dataset, std::move(data)));
+}
+
+// HDF5AsyncWriter.cc ends here
@@ -0,0 +1,125 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 10:12:40 sb"
+
+/*
+  file       HDF5AsyncWriter.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Queue HDF5::File writes and execute them on a dedicated I/O thread
+  so that compression and disk access overlap with computation.
+
+  Buffers are moved into the queue, never copied. If the queued data
+  exceeds max_pending_bytes, the writing thread blocks until the I/O
+  thread has caught up. Flush() returns once everything queued before
+  it is on disk.
+
+  libhdf5 is usually not compiled thread-safe. While an AsyncWriter
+  is alive, do not touch the underlying File from any other thread.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef HDF5ASYNCWRITER_HH__20D35448_CF73_41CD_8E76_388DF8A787BD
+#define HDF5ASYNCWRITER_HH__20D35448_CF73_41CD_8E76_388DF8A787BD
+
+#include <sbutil/HDF5File.hh>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+
+namespace HDF5
+{
+  class AsyncWriter {
+    public:
+      // One queued operation, executed on the I/O thread.
+      class Job {
+        public:
+          virtual ~Job(){}
+          virtual void Run(File& file) = 0;
+          virtual size_t Bytes() const = 0;
+      };
+
+    private:
+      File& file;
+      size_t max_pending_bytes;
+      size_t pending_bytes;
+      unsigned long long jobs_queued;
+      unsigned long long jobs_done;
+      bool stop;
+      std::exception_ptr error;
+      std::deque<Job*> queue;
+      std::mutex mutex;
+      std::condition_variable cond_work;
+      std::condition_variable cond_done;
+      std::thread io_thread;
+
+      // make non-copyable
+      AsyncWriter(const AsyncWriter&);
+      AsyncWriter& operator=(const AsyncWriter&);
+
+      void Loop();
+      void RethrowError();
+
+    public:
+      AsyncWriter(File& file_, size_t max_pending_bytes_ = 256u << 20);
+
+      // Flushes all pending writes. Errors are not reported, call
+      // Flush() explicitly before destruction to see them.
+      ~AsyncWriter();
+
+      // Take ownership of JOB and queue it. Blocks while too much data
+      // is pending. Rethrows the first exception raised on the I/O
+      // thread. Returns the ticket of JOB: it has completed once that
+      // many jobs are done.
+      unsigned long long Push(Job* job);
+
+      // Block until all jobs queued so far have completed and the file
+      // has been flushed to disk. Rethrows the first exception raised
+      // on the I/O thread.
+      void Flush();
+
+      // Bytes currently waiting in the queue.
+      size_t GetPendingBytes();
+
+      // Asynchronous counterparts of File::Write*. DATA is moved from
+      // and left empty.
+      void WriteDatasetDouble(const std::string& path,
+                              const std::string& name,
+                              const std::vector<size_t>& dimensions,
+                              std::vector<double>&& data);
+      void WriteDatasetDouble(const std::string& path,
+                              const std::string& name,
+                              const std::vector<size_t>& dimensions,
+                              std::vector<double>&& data,
+                              const WriteOptions& options);
+      void WriteDatasetInt(const std::string& path,
+                           const std::string& name,
+                           const std::vector<size_t>& dimensions,
+                           std::vector<int>&& data);
+      void WriteDatasetInt(const std::string& path,
+                           const std::string& name,
+                           const std::vector<size_t>& dimensions,
+                           std::vector<int>&& data,
+                           const WriteOptions& options);
+      void WriteVectorDouble(const std::string& path,
+                             const std::string& name,
+                             std::vector<double>&& data);
+      void WriteVectorInt(const std::string& path,
+                          const std::string& name,
+                          std::vector<int>&& data);
+
+      // Append rows to DATASET on the I/O thread. DATASET must outlive
+      // the next Flush().
+      void Append(AppendableDataset& dataset, std::vector<double>&& data);
+      void Append(AppendableDataset& dataset, std::vector<int>&& data);
+  };
+}
+
+#endif // HDF5ASYNCWRITER_HH__20D35448_CF73_41CD_8E76_388DF8A787BD
+
+// HDF5AsyncWriter.hh ends here
@@ -18,6 +18,7 @@
 
 
 #include <sstream>
+#include <algorithm>
 #include <cassert>
 
 using namespace HDF5;
@@ -48,9 +49,64 @@ ErrorMessageSuppressor::~ErrorMessageSuppressor(){
   H5CALL(H5Eset_auto1, func, client_data);
 }
 
+static bool path_is_root(const std::string& path){
+  return path == "" || path == "/";
+}
+
+// ---------------------------------------------------------------- CompoundType
+
+CompoundType::CompoundType(size_t size)
+  : type_id(0)
+{
+  if((type_id = H5Tcreate(H5T_COMPOUND, size)) < 0){
+    type_id = 0;
+    std::ostringstream os;
+    os << "H5Tcreate(H5T_COMPOUND, " << size << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+}
+
+CompoundType::~CompoundType(){
+  if(type_id){
+    H5Tclose(type_id);
+    type_id = 0;
+  }
+}
+
+CompoundType& CompoundType::Insert(const std::string& name,
+                                   size_t offset,
+                                   hid_t member_type)
+{
+  H5CALL(H5Tinsert, type_id, name.c_str(), offset, member_type);
+  return *this;
+}
+
+CompoundType& CompoundType::InsertArray(const std::string& name,
+                                        size_t offset,
+                                        hid_t base_type,
+                                        const std::vector<size_t>& dims)
+{
+  std::vector<hsize_t> d(dims.begin(), dims.end());
+  hid_t array_type = H5Tarray_create2(base_type, d.size(), &d[0]);
+  if(array_type < 0){
+    std::ostringstream os;
+    os << "H5Tarray_create2(" << vector_form<hsize_t>(d) << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+  // H5Tinsert copies the member type
+  herr_t rc = H5Tinsert(type_id, name.c_str(), offset, array_type);
+  H5Tclose(array_type);
+  if(rc < 0){
+    std::ostringstream os;
+    os << "H5Tinsert(" << name << ", " << offset << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+  return *this;
+}
+
 // ------------------------------------------------------------------ Properties
 
-Properties::Properties(const int identifier_)
+Properties::Properties(const hid_t identifier_)
   : identifier(identifier_),
     prop_id(0)
 {
@@ -108,10 +164,142 @@ void PropDatasetCreate::SetChunk(const std::vector<size_t>& dims,
   H5CALL(H5Pset_chunk, prop_id, dc.size(), &dc[0]);
 }
 
+void PropDatasetCreate::SetChunkDimensions(const std::vector<hsize_t>& chunk_dims){
+  std::vector<hsize_t> dc(chunk_dims);
+  H5CALL(H5Pset_chunk, prop_id, dc.size(), &dc[0]);
+}
+
+void PropDatasetCreate::SetChunkBytes(const std::vector<size_t>& dims,
+                                      size_t element_size,
+                                      size_t target_bytes)
+{
+  std::vector<hsize_t> dc(dims.size());
+  size_t bytes = element_size;
+  for(size_t i=0; i<dims.size(); ++i){
+    dc[i] = std::max<size_t>(dims[i], 1);
+    bytes *= dc[i];
+  }
+  // Shrink the slowest varying dimension first, down to one element,
+  // before touching the next one. The last dimension that has to
+  // shrink takes as many elements as fit into the remaining budget.
+  for(size_t i=0; i<dc.size() && bytes > target_bytes; ++i){
+    const size_t slab = bytes / dc[i];
+    if(slab <= target_bytes){
+      dc[i] = std::max<size_t>(1, target_bytes / slab);
+      bytes = slab * dc[i];
+    }
+    else{
+      dc[i] = 1;
+      bytes = slab;
+    }
+  }
+  assert(bytes <= target_bytes ||
+         std::count(dc.begin(), dc.end(), (hsize_t)1) == (std::ptrdiff_t)dc.size());
+  SetChunkDimensions(dc);
+}
+
 void PropDatasetCreate::SetDeflate(int level){
   H5CALL(H5Pset_deflate, prop_id, level);
 }
 
+void PropDatasetCreate::SetShuffle(){
+  H5CALL(H5Pset_shuffle, prop_id);
+}
+
+void PropDatasetCreate::SetFletcher32(){
+  H5CALL(H5Pset_fletcher32, prop_id);
+}
+
+void PropDatasetCreate::Set(const WriteOptions& options,
+                            const std::vector<size_t>& dims,
+                            size_t element_size)
+{
+  if(!options.HasFilters()){
+    return;
+  }
+  if(options.chunk_bytes > 0){
+    SetChunkBytes(dims, element_size, options.chunk_bytes);
+  }
+  else{
+    SetChunk(dims, options.max_chunk_size);
+  }
+  SetFilters(options);
+}
+
+void PropDatasetCreate::SetFilters(const WriteOptions& options){
+  // Filters run in the order they were added. Checksum the raw data
+  // last so that corruption of the compressed chunk is detected.
+  if(options.shuffle){
+    SetShuffle();
+  }
+  if(options.deflate_level >= 0){
+    SetDeflate(options.deflate_level);
+  }
+  if(options.fletcher32){
+    SetFletcher32();
+  }
+}
+
+void PropDatasetCreate::AddVirtualMapping(const Dataspace& virtual_space,
+                                          const std::string& source_filename,
+                                          const std::string& source_dataset,
+                                          const Dataspace& source_space)
+{
+#if H5_VERSION_GE(1, 10, 0)
+  H5CALL(H5Pset_virtual, prop_id, virtual_space.GetId(),
+         source_filename.c_str(), source_dataset.c_str(),
+         source_space.GetId());
+#else
+  (void)virtual_space;
+  (void)source_space;
+  std::ostringstream os;
+  os << "Cannot map " << source_filename << ":" << source_dataset
+     << ", virtual datasets need HDF5 >= 1.10.";
+  throw EXCEPTION(os.str());
+#endif
+}
+
+// -------------------------------------------------------------------- Hyperslab
+
+Hyperslab::Hyperslab(const std::vector<size_t>& start_,
+                     const std::vector<size_t>& count_)
+  : start(start_.begin(), start_.end()),
+    stride(),
+    count(count_.begin(), count_.end()),
+    block()
+{
+  assert(start.size() == count.size());
+}
+
+Hyperslab::Hyperslab(const std::vector<size_t>& start_,
+                     const std::vector<size_t>& stride_,
+                     const std::vector<size_t>& count_)
+  : start(start_.begin(), start_.end()),
+    stride(stride_.begin(), stride_.end()),
+    count(count_.begin(), count_.end()),
+    block()
+{
+  assert(start.size() == count.size());
+  assert(start.size() == stride.size());
+}
+
+std::vector<size_t> Hyperslab::Dimensions() const {
+  std::vector<size_t> rc(count.size());
+  for(size_t i=0; i<count.size(); ++i){
+    rc[i] = count[i] * (block.empty() ? 1 : block[i]);
+  }
+  return rc;
+}
+
+size_t Hyperslab::Size() const {
+  const std::vector<size_t> d = Dimensions();
+  size_t rc = 1;
+  for(size_t i=0; i<d.size(); ++i){
+    rc *= d[i];
+  }
+  return rc;
+}
+
 // -------------------------------------------------------------------- Dataspace
 
 Dataspace::Dataspace(const std::vector<size_t>& dims)
@@ -128,6 +316,33 @@ Dataspace::Dataspace(const std::vector<size_t>& dims)
   }
 }
 
+Dataspace::Dataspace(const std::vector<size_t>& dims,
+                     const std::vector<hsize_t>& max_dims)
+  : dataspace_id(0)
+{
+  assert(dims.size() == max_dims.size());
+  std::vector<hsize_t> d(dims.size());
+  std::vector<hsize_t> m(max_dims);
+  for(size_t i=0; i<d.size(); ++i){
+    d[i] = dims[i];
+  }
+  if((dataspace_id = H5Screate_simple(d.size(), &d[0], &m[0])) < 0){
+    std::ostringstream os;
+    os << "H5Screate_simple(" << vector_form<hsize_t>(d) << ", "
+       << vector_form<hsize_t>(m) << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+}
+
+Dataspace::Dataspace(hid_t dataspace_id_)
+  : dataspace_id(dataspace_id_)
+{
+  if(dataspace_id < 0){
+    dataspace_id = 0;
+    throw EXCEPTION("Invalid dataspace identifier.");
+  }
+}
+
 Dataspace::~Dataspace(){
   if(dataspace_id){
     H5Sclose(dataspace_id);
@@ -135,6 +350,43 @@ Dataspace::~Dataspace(){
   }
 }
 
+std::vector<size_t> Dataspace::GetDimensions() const {
+  const int rank = H5Sget_simple_extent_ndims(dataspace_id);
+  if(rank < 0){
+    throw EXCEPTION("H5Sget_simple_extent_ndims() failed.");
+  }
+  std::vector<hsize_t> d(rank + 1, 0);
+  H5CALL(H5Sget_simple_extent_dims, dataspace_id, &d[0], (hsize_t*)NULL);
+  return std::vector<size_t>(d.begin(), d.begin() + rank);
+}
+
+size_t Dataspace::GetSelectedSize() const {
+  const hssize_t n = H5Sget_select_npoints(dataspace_id);
+  if(n < 0){
+    throw EXCEPTION("H5Sget_select_npoints() failed.");
+  }
+  return n;
+}
+
+void Dataspace::Select(const Hyperslab& slab){
+  const int rank = H5Sget_simple_extent_ndims(dataspace_id);
+  if(rank != (int)slab.Rank() ||
+     slab.count.size() != slab.Rank() ||
+     (!slab.stride.empty() && slab.stride.size() != slab.Rank()) ||
+     (!slab.block.empty() && slab.block.size() != slab.Rank()))
+  {
+    std::ostringstream os;
+    os << "Hyperslab of rank " << slab.Rank()
+       << " does not match dataspace of rank " << rank << ".";
+    throw EXCEPTION(os.str());
+  }
+  H5CALL(H5Sselect_hyperslab, dataspace_id, H5S_SELECT_SET,
+         &slab.start[0],
+         slab.stride.empty() ? (const hsize_t*)NULL : &slab.stride[0],
+         &slab.count[0],
+         slab.block.empty() ? (const hsize_t*)NULL : &slab.block[0]);
+}
+
 // ------------------------------------------------------------------------ Group
 
 Group::Group()
@@ -214,11 +466,12 @@ Dataset::~Dataset() {
 void Dataset::Create(hid_t parent,
                      const std::string& name,
                      PropDatasetCreate& prop_dataset_create,
-                     Dataspace& dataspace)
+                     Dataspace& dataspace,
+                     hid_t datatype)
 {
   if((dataset_id = H5Dcreate(parent,
                              name.c_str(),
-                             H5T_IEEE_F64LE,
+                             datatype,
                              dataspace.GetId(),
                              H5P_DEFAULT,
                              prop_dataset_create.GetId(),
@@ -233,17 +486,19 @@ void Dataset::Create(hid_t parent,
 void Dataset::Create(Group& group,
                      const std::string& name,
                      PropDatasetCreate& prop_dataset_create,
-                     Dataspace& dataspace)
+                     Dataspace& dataspace,
+                     hid_t datatype)
 {
-  Create(group.GetId(), name, prop_dataset_create, dataspace);
+  Create(group.GetId(), name, prop_dataset_create, dataspace, datatype);
 }
 
 void Dataset::Create(File& file,
                      const std::string& name,
                      PropDatasetCreate& prop_dataset_create,
-                     Dataspace& dataspace)
+                     Dataspace& dataspace,
+                     hid_t datatype)
 {
-  Create(file.GetId(), name, prop_dataset_create, dataspace);
+  Create(file.GetId(), name, prop_dataset_create, dataspace, datatype);
 }
 
 void Dataset::Write(const double* data){
@@ -256,6 +511,275 @@ void Dataset::Write(const int* data){
          H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
 }
 
+void Dataset::Write(hid_t memory_type, const void* data){
+  H5CALL(H5Dwrite, dataset_id, memory_type,
+         H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+}
+
+bool Dataset::Open(hid_t parent, const std::string& name){
+  if(dataset_id){
+    H5Dclose(dataset_id);
+    dataset_id = 0;
+  }
+  ErrorMessageSuppressor e;
+  if((dataset_id = H5Dopen(parent, name.c_str(), H5P_DEFAULT)) < 0){
+    dataset_id = 0;
+    return false;
+  }
+  return true;
+}
+
+bool Dataset::Open(Group& group, const std::string& name){
+  return Open(group.GetId(), name);
+}
+
+bool Dataset::Open(File& file, const std::string& name){
+  return Open(file.GetId(), name);
+}
+
+std::vector<size_t> Dataset::GetDimensions() const {
+  Dataspace space(H5Dget_space(dataset_id));
+  return space.GetDimensions();
+}
+
+void Dataset::Read(hid_t memory_type,
+                   const Dataspace& memory_space,
+                   void* data,
+                   const Hyperslab* slab)
+{
+  Dataspace file_space(H5Dget_space(dataset_id));
+  if(slab){
+    file_space.Select(*slab);
+  }
+  const size_t n_file = file_space.GetSelectedSize();
+  const size_t n_memory = memory_space.GetSelectedSize();
+  if(n_file != n_memory){
+    std::ostringstream os;
+    os << "Cannot read " << n_file << " elements from dataset into "
+       << n_memory << " elements of memory.";
+    throw EXCEPTION(os.str());
+  }
+  H5CALL(H5Dread, dataset_id, memory_type, memory_space.GetId(),
+         file_space.GetId(), H5P_DEFAULT, data);
+}
+
+void Dataset::Read(hid_t memory_type, void* data, const Hyperslab* slab){
+  if(!slab){
+    H5CALL(H5Dread, dataset_id, memory_type,
+           H5S_ALL, H5S_ALL, H5P_DEFAULT, data);
+    return;
+  }
+  Dataspace memory_space(slab->Dimensions());
+  Read(memory_type, memory_space, data, slab);
+}
+
+void Dataset::Read(double* data, const Hyperslab* slab){
+  Read(H5T_NATIVE_DOUBLE, data, slab);
+}
+
+void Dataset::Read(int* data, const Hyperslab* slab){
+  Read(H5T_NATIVE_INT, data, slab);
+}
+
+
+// ------------------------------------------------------------ AppendableDataset
+
+// Target size of one chunk if the number of rows per chunk is not
+// given explicitly.
+static const size_t APPENDABLE_CHUNK_BYTES = 1 << 16;
+
+// The stored type of DATASET_ID can hold elements of TYPE: equal
+// types, or atomic types of the same class and size that only differ
+// in byte order or similar conversions HDF5 does on write.
+static bool compatible_types(hid_t dataset_id, hid_t type){
+  const hid_t stored = H5Dget_type(dataset_id);
+  if(stored < 0){
+    return false;
+  }
+  bool rc = H5Tequal(stored, type) > 0;
+  if(!rc){
+    const H5T_class_t c = H5Tget_class(stored);
+    rc = c == H5Tget_class(type) &&
+      c != H5T_COMPOUND && c != H5T_ARRAY && c != H5T_VLEN &&
+      H5Tget_size(stored) == H5Tget_size(type);
+  }
+  H5Tclose(stored);
+  return rc;
+}
+
+AppendableDataset::AppendableDataset(File& file,
+                                     const std::string& path,
+                                     const std::string& name,
+                                     const std::vector<size_t>& row_dimensions,
+                                     hid_t datatype_,
+                                     size_t chunk_rows,
+                                     const WriteOptions& options)
+  : dataset_id(0),
+    datatype(datatype_),
+    row_dims(row_dimensions.begin(), row_dimensions.end()),
+    row_size(1),
+    rows(0)
+{
+  for(size_t i=0; i<row_dims.size(); ++i){
+    row_size *= row_dims[i];
+  }
+  if(row_size == 0){
+    throw EXCEPTION("AppendableDataset needs rows with nonzero size.");
+  }
+
+  const hid_t parent = file.GetGroupId(path);
+
+  { // try to continue an existing dataset first
+    ErrorMessageSuppressor e;
+    dataset_id = H5Dopen(parent, name.c_str(), H5P_DEFAULT);
+  }
+
+  if(dataset_id >= 0){
+    // The destructor does not run if the constructor throws, so close
+    // the dataset on every error below.
+    try{
+      Dataspace space(H5Dget_space(dataset_id));
+      const int rank = H5Sget_simple_extent_ndims(space.GetId());
+      std::vector<hsize_t> dims(rank > 0 ? rank : 1, 0);
+      std::vector<hsize_t> max_dims(dims);
+      H5CALL(H5Sget_simple_extent_dims, space.GetId(), &dims[0], &max_dims[0]);
+
+      std::ostringstream os;
+      if(rank != (int)row_dims.size() + 1 ||
+         !std::equal(row_dims.begin(), row_dims.end(), dims.begin() + 1))
+      {
+        os << "Existing dataset " << path << "/" << name << " has dimensions "
+           << vector_form<hsize_t>(dims) << ", cannot append rows of shape "
+           << vector_form<hsize_t>(row_dims) << ".";
+      }
+      else if(max_dims[0] != H5S_UNLIMITED){
+        os << "Existing dataset " << path << "/" << name
+           << " cannot be extended, dimension 0 is not unlimited.";
+      }
+      else if(!compatible_types(dataset_id, datatype)){
+        os << "Existing dataset " << path << "/" << name
+           << " has a different datatype than the rows to append.";
+      }
+      if(!os.str().empty()){
+        throw EXCEPTION(os.str());
+      }
+      rows = dims[0];
+    }
+    catch(...){
+      H5Dclose(dataset_id);
+      dataset_id = 0;
+      throw;
+    }
+    return;
+  }
+  dataset_id = 0;
+
+  if(chunk_rows == 0){
+    const size_t row_bytes = row_size * H5Tget_size(datatype);
+    const size_t chunk_bytes =
+      options.chunk_bytes > 0 ? options.chunk_bytes : APPENDABLE_CHUNK_BYTES;
+    chunk_rows = std::max<size_t>(1, chunk_bytes / row_bytes);
+  }
+
+  std::vector<size_t> dims(1, 0);
+  dims.insert(dims.end(), row_dimensions.begin(), row_dimensions.end());
+  std::vector<hsize_t> max_dims(row_dims);
+  max_dims.insert(max_dims.begin(), H5S_UNLIMITED);
+  Dataspace dataspace(dims, max_dims);
+
+  std::vector<hsize_t> chunk_dims(row_dims);
+  chunk_dims.insert(chunk_dims.begin(), chunk_rows);
+  PropDatasetCreate p_dataset_create;
+  p_dataset_create.SetChunkDimensions(chunk_dims);
+  p_dataset_create.SetFilters(options);
+
+  if((dataset_id = H5Dcreate(parent,
+                             name.c_str(),
+                             datatype,
+                             dataspace.GetId(),
+                             H5P_DEFAULT,
+                             p_dataset_create.GetId(),
+                             H5P_DEFAULT)) < 0)
+  {
+    dataset_id = 0;
+    std::ostringstream os;
+    os << "H5Dcreate(" << name << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+}
+
+AppendableDataset::~AppendableDataset(){
+  if(dataset_id){
+    H5Dclose(dataset_id);
+    dataset_id = 0;
+  }
+}
+
+void AppendableDataset::Append(hid_t memory_type,
+                               const void* block,
+                               size_t n_rows)
+{
+  if(n_rows == 0){
+    return;
+  }
+  assert(block);
+
+  std::vector<hsize_t> extent(row_dims);
+  extent.insert(extent.begin(), rows + n_rows);
+  H5CALL(H5Dset_extent, dataset_id, &extent[0]);
+
+  std::vector<hsize_t> start(extent.size(), 0);
+  start[0] = rows;
+  std::vector<hsize_t> count(row_dims);
+  count.insert(count.begin(), n_rows);
+
+  Dataspace file_space(H5Dget_space(dataset_id));
+  H5CALL(H5Sselect_hyperslab, file_space.GetId(), H5S_SELECT_SET,
+         &start[0], (const hsize_t*)NULL, &count[0], (const hsize_t*)NULL);
+
+  std::vector<size_t> memory_dims(count.begin(), count.end());
+  Dataspace memory_space(memory_dims);
+
+  H5CALL(H5Dwrite, dataset_id, memory_type, memory_space.GetId(),
+         file_space.GetId(), H5P_DEFAULT, block);
+  rows += n_rows;
+}
+
+void AppendableDataset::Append(const double* block, size_t n_rows){
+  Append(H5T_NATIVE_DOUBLE, block, n_rows);
+}
+
+void AppendableDataset::Append(const int* block, size_t n_rows){
+  Append(H5T_NATIVE_INT, block, n_rows);
+}
+
+void AppendableDataset::Append(const std::vector<double>& data){
+  if(data.size() % row_size != 0){
+    std::ostringstream os;
+    os << "Cannot append " << data.size() << " values in rows of "
+       << row_size << ".";
+    throw EXCEPTION(os.str());
+  }
+  if(!data.empty()){
+    Append(&data[0], data.size() / row_size);
+  }
+}
+
+void AppendableDataset::Append(const std::vector<int>& data){
+  if(data.size() % row_size != 0){
+    std::ostringstream os;
+    os << "Cannot append " << data.size() << " values in rows of "
+       << row_size << ".";
+    throw EXCEPTION(os.str());
+  }
+  if(!data.empty()){
+    Append(&data[0], data.size() / row_size);
+  }
+}
+
+void AppendableDataset::Flush(){
+  H5CALL(H5Fflush, dataset_id, H5F_SCOPE_LOCAL);
+}
 
 // ------------------------------------------------------------------------- File
 
@@ -264,7 +788,10 @@ File::File(const std::string& filename_,
            bool append_)
   : filename(filename_),
     file_id(0),
-    max_chunk_size(64)
+    write_options(),
+    group_cache(),
+    prop_dataset_cache(),
+    prop_link_create(NULL)
 {
   Open(filename_, append_);
 }
@@ -274,6 +801,8 @@ File::~File(){
 }
 
 void File::Open(const std::string& filename_, bool append_){
+  Close();
+
   hid_t id = 0;
   if(append_){
     { // try opening for read-write access first. Fail quietly and then try
@@ -302,75 +831,205 @@ void File::Open(const std::string& filename_, bool append_){
   file_id = id;
 }
 
+void File::ClearCache(){
+  for(std::map<std::string, Group*>::iterator i = group_cache.begin();
+      i != group_cache.end(); ++i)
+  {
+    delete i->second;
+  }
+  group_cache.clear();
+
+  for(std::map<std::string, PropDatasetCreate*>::iterator i =
+        prop_dataset_cache.begin();
+      i != prop_dataset_cache.end(); ++i)
+  {
+    delete i->second;
+  }
+  prop_dataset_cache.clear();
+
+  if(prop_link_create){
+    delete prop_link_create;
+    prop_link_create = NULL;
+  }
+}
+
 void File::Close(){
+  // Cached handles must be released before the file can really close.
+  ClearCache();
   if(file_id){
     H5Fclose(file_id);
     file_id = 0;
   }
 }
 
-static bool path_is_root(const std::string& path){
-  return path == "" || path == "/";
+void File::Flush(){
+  if(file_id){
+    H5CALL(H5Fflush, file_id, H5F_SCOPE_GLOBAL);
+  }
 }
 
-void File::WriteDatasetDouble(const std::string& path,
-                              const std::string& name,
-                              const std::vector<size_t>& dimensions,
-                              const double* data)
-{
-  PropLinkCreate p_link_create;
-
-  Group group;
+void File::OpenOrCreateGroup(const std::string& path, Group& group){
   if(!path_is_root(path)){
     if(!group.Open(*this, path)){
-      group.Create(*this, path, p_link_create);
+      if(!prop_link_create){
+        prop_link_create = new PropLinkCreate;
+      }
+      group.Create(*this, path, *prop_link_create);
     }
   }
+}
 
-  Dataspace dataspace(dimensions);
-
-  PropDatasetCreate p_dataset_create;
-  p_dataset_create.SetChunk(dimensions, max_chunk_size);
-  p_dataset_create.SetDeflate(9);
+Group* File::GetGroup(const std::string& path){
+  if(path_is_root(path)){
+    return NULL;
+  }
+  std::map<std::string, Group*>::iterator i = group_cache.find(path);
+  if(i != group_cache.end()){
+    return i->second;
+  }
 
-  Dataset dataset;
-  if(!path_is_root(path)){
-    dataset.Create(group, name, p_dataset_create, dataspace);
+  Group* group = new Group;
+  try{
+    OpenOrCreateGroup(path, *group);
   }
-  else{
-    dataset.Create(*this, name, p_dataset_create, dataspace);
+  catch(...){
+    delete group;
+    throw;
   }
-  dataset.Write(data);
+  group_cache[path] = group;
+  return group;
 }
 
-void File::WriteDatasetInt(const std::string& path,
-                           const std::string& name,
-                           const std::vector<size_t>& dimensions,
-                           const int* data)
+hid_t File::GetGroupId(const std::string& path){
+  Group* group = GetGroup(path);
+  return group ? group->GetId() : file_id;
+}
+
+// Upper limit on the number of cached dataset creation property lists.
+// These depend on the dataset shape, so a file with datasets of many
+// different shapes would otherwise collect them without bound.
+static const size_t PROP_DATASET_CACHE_SIZE = 64;
+
+PropDatasetCreate& File::GetPropDatasetCreate(const WriteOptions& options,
+                                              const std::vector<size_t>& dims,
+                                              size_t element_size)
 {
-  PropLinkCreate p_link_create;
+  // Without filters, the property list is independent of the shape.
+  std::ostringstream os;
+  if(options.HasFilters()){
+    os << options.deflate_level << ":" << options.shuffle << ":"
+       << options.fletcher32 << ":" << options.chunk_bytes << ":"
+       << options.max_chunk_size << ":" << element_size << ":"
+       << vector_form<size_t>(dims);
+  }
+  const std::string key = os.str();
 
-  Group group;
-  if(!path_is_root(path)){
-    if(!group.Open(*this, path)){
-      group.Create(*this, path, p_link_create);
+  std::map<std::string, PropDatasetCreate*>::iterator i =
+    prop_dataset_cache.find(key);
+  if(i != prop_dataset_cache.end()){
+    return *(i->second);
+  }
+
+  if(prop_dataset_cache.size() >= PROP_DATASET_CACHE_SIZE){
+    for(i = prop_dataset_cache.begin(); i != prop_dataset_cache.end(); ++i){
+      delete i->second;
     }
+    prop_dataset_cache.clear();
   }
 
-  Dataspace dataspace(dimensions);
+  PropDatasetCreate* p = new PropDatasetCreate;
+  try{
+    p->Set(options, dims, element_size);
+  }
+  catch(...){
+    delete p;
+    throw;
+  }
+  prop_dataset_cache[key] = p;
+  return *p;
+}
 
-  PropDatasetCreate p_dataset_create;
-  p_dataset_create.SetChunk(dimensions, max_chunk_size);
-  p_dataset_create.SetDeflate(9);
+static void write_dataset(File& file,
+                          Group* group,
+                          const std::string& name,
+                          const std::vector<size_t>& dimensions,
+                          hid_t file_type,
+                          hid_t memory_type,
+                          const void* data,
+                          PropDatasetCreate& p_dataset_create)
+{
+  Dataspace dataspace(dimensions);
 
   Dataset dataset;
-  if(!path_is_root(path)){
-    dataset.Create(group, name, p_dataset_create, dataspace);
+  if(group){
+    dataset.Create(*group, name, p_dataset_create, dataspace, file_type);
   }
   else{
-    dataset.Create(*this, name, p_dataset_create, dataspace);
+    dataset.Create(file, name, p_dataset_create, dataspace, file_type);
+  }
+  dataset.Write(memory_type, data);
+}
+
+void File::WriteDatasetDouble(const std::string& path,
+                              const std::string& name,
+                              const std::vector<size_t>& dimensions,
+                              const double* data,
+                              const WriteOptions& options)
+{
+  write_dataset(*this, GetGroup(path), name, dimensions,
+                H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, data,
+                GetPropDatasetCreate(options, dimensions, sizeof(double)));
+}
+
+void File::WriteDatasetInt(const std::string& path,
+                           const std::string& name,
+                           const std::vector<size_t>& dimensions,
+                           const int* data,
+                           const WriteOptions& options)
+{
+  write_dataset(*this, GetGroup(path), name, dimensions,
+                H5T_IEEE_F64LE, H5T_NATIVE_INT, data,
+                GetPropDatasetCreate(options, dimensions, sizeof(int)));
+}
+
+void File::WriteDataset(const std::string& path,
+                        const std::string& name,
+                        const std::vector<size_t>& dimensions,
+                        hid_t file_type,
+                        hid_t memory_type,
+                        const void* data,
+                        const WriteOptions& options)
+{
+  write_dataset(*this, GetGroup(path), name, dimensions,
+                file_type, memory_type, data,
+                GetPropDatasetCreate(options, dimensions,
+                                     H5Tget_size(file_type)));
+}
+
+void File::WriteDatasetsDouble(const std::string& path,
+                               const std::vector<NamedData<double> >& datasets,
+                               const WriteOptions& options)
+{
+  Group* group = GetGroup(path);
+  for(size_t i=0; i<datasets.size(); ++i){
+    const NamedData<double>& d = datasets[i];
+    write_dataset(*this, group, d.name, d.dimensions,
+                  H5T_IEEE_F64LE, H5T_NATIVE_DOUBLE, d.data,
+                  GetPropDatasetCreate(options, d.dimensions, sizeof(double)));
+  }
+}
+
+void File::WriteDatasetsInt(const std::string& path,
+                            const std::vector<NamedData<int> >& datasets,
+                            const WriteOptions& options)
+{
+  Group* group = GetGroup(path);
+  for(size_t i=0; i<datasets.size(); ++i){
+    const NamedData<int>& d = datasets[i];
+    write_dataset(*this, group, d.name, d.dimensions,
+                  H5T_IEEE_F64LE, H5T_NATIVE_INT, d.data,
+                  GetPropDatasetCreate(options, d.dimensions, sizeof(int)));
   }
-  dataset.Write(data);
 }
 
 
@@ -438,4 +1097,484 @@ void  File::WriteGSLMatrix(const std::string& path,
   WriteDatasetDouble(path, name, dims, matrix->data);
 }
 
+static std::string dataset_path(const std::string& path,
+                                const std::string& name)
+{
+  if(path_is_root(path)){
+    return "/" + name;
+  }
+  return path + "/" + name;
+}
+
+void File::OpenDataset(const std::string& path,
+                       const std::string& name,
+                       Dataset& dataset)
+{
+  const std::string p = dataset_path(path, name);
+  if(!dataset.Open(*this, p)){
+    std::ostringstream os;
+    os << "Dataset " << p << " not found in " << filename << ".";
+    throw EXCEPTION(os.str());
+  }
+}
+
+static size_t product(const std::vector<size_t>& dims){
+  size_t rc = 1;
+  for(size_t i=0; i<dims.size(); ++i){
+    rc *= dims[i];
+  }
+  return rc;
+}
+
+std::vector<size_t> File::GetDatasetDimensions(const std::string& path,
+                                               const std::string& name)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  return dataset.GetDimensions();
+}
+
+void File::ReadDatasetDouble(const std::string& path,
+                             const std::string& name,
+                             double* data,
+                             const Hyperslab* slab)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  dataset.Read(data, slab);
+}
+
+void File::ReadDatasetDouble(const std::string& path,
+                             const std::string& name,
+                             std::vector<double>& data,
+                             const Hyperslab* slab)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  data.resize(slab ? slab->Size() : product(dataset.GetDimensions()));
+  if(!data.empty()){
+    dataset.Read(&data[0], slab);
+  }
+}
+
+void File::ReadDatasetInt(const std::string& path,
+                          const std::string& name,
+                          int* data,
+                          const Hyperslab* slab)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  dataset.Read(data, slab);
+}
+
+void File::ReadDatasetInt(const std::string& path,
+                          const std::string& name,
+                          std::vector<int>& data,
+                          const Hyperslab* slab)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  data.resize(slab ? slab->Size() : product(dataset.GetDimensions()));
+  if(!data.empty()){
+    dataset.Read(&data[0], slab);
+  }
+}
+
+void File::ReadStrided(const std::string& path,
+                       const std::string& name,
+                       double* data,
+                       const std::vector<size_t>& memory_dims,
+                       const Hyperslab& memory_slab,
+                       const Hyperslab* slab)
+{
+  Dataset dataset;
+  OpenDataset(path, name, dataset);
+  Dataspace memory_space(memory_dims);
+  memory_space.Select(memory_slab);
+  dataset.Read(H5T_NATIVE_DOUBLE, memory_space, data, slab);
+}
+
+// GSL storage is described as a (possibly strided) selection of a
+// larger memory dataspace, so that HDF5 scatters directly into it.
+
+void File::ReadGSLVector(const std::string& path,
+                         const std::string& name,
+                         gsl_vector* v,
+                         const Hyperslab* slab)
+{
+  assert(v);
+  std::vector<size_t> dims(1, (v->size - 1) * v->stride + 1);
+  std::vector<size_t> start(1, 0), stride(1, v->stride), count(1, v->size);
+  ReadStrided(path, name, v->data, dims,
+              Hyperslab(start, stride, count), slab);
+}
+
+void File::ReadGSLVector(const std::string& path,
+                         const std::string& name,
+                         gsl_vector_complex* v,
+                         const Hyperslab* slab)
+{
+  assert(v);
+  std::vector<size_t> dims(2, 2u);
+  dims[0] = (v->size - 1) * v->stride + 1;
+  std::vector<size_t> start(2, 0u), stride(2, 1u), count(2, 2u);
+  stride[0] = v->stride;
+  count[0] = v->size;
+  ReadStrided(path, name, v->data, dims,
+              Hyperslab(start, stride, count), slab);
+}
+
+void File::ReadGSLMatrix(const std::string& path,
+                         const std::string& name,
+                         gsl_matrix* matrix,
+                         const Hyperslab* slab)
+{
+  assert(matrix);
+  std::vector<size_t> dims(2, 0u);
+  dims[0] = matrix->size1;
+  dims[1] = matrix->tda;
+  std::vector<size_t> start(2, 0u), count(2, 0u);
+  count[0] = matrix->size1;
+  count[1] = matrix->size2;
+  ReadStrided(path, name, matrix->data, dims,
+              Hyperslab(start, count), slab);
+}
+
+void File::ReadGSLMatrix(const std::string& path,
+                         const std::string& name,
+                         gsl_matrix_complex* matrix,
+                         const Hyperslab* slab)
+{
+  assert(matrix);
+  std::vector<size_t> dims(3, 2u);
+  dims[0] = matrix->size1;
+  dims[1] = matrix->tda;
+  std::vector<size_t> start(3, 0u), count(3, 2u);
+  count[0] = matrix->size1;
+  count[1] = matrix->size2;
+  ReadStrided(path, name, matrix->data, dims,
+              Hyperslab(start, count), slab);
+}
+
+// ------------------------------------------------------------- Virtual datasets
+
+std::string HDF5::ShardFilename(const std::string& base, size_t index){
+  std::ostringstream os;
+  os << base << "." << right_justified<size_t>(index, 5, '0') << ".h5";
+  return os.str();
+}
+
+// Read the shape of dataset NAME in file FILENAME without keeping the
+// file open.
+// Where the library looks for source file SOURCE of a virtual dataset
+// stored in VDS_FILENAME: relative names are taken relative to the
+// directory of the virtual dataset's file, "." is that file itself.
+static std::string resolve_source_filename(const std::string& vds_filename,
+                                           const std::string& source)
+{
+  if(source == "."){
+    return vds_filename;
+  }
+  if(source.empty() || source[0] == '/'){
+    return source;
+  }
+  const std::string::size_type slash = vds_filename.rfind('/');
+  if(slash == std::string::npos){
+    return source;
+  }
+  return vds_filename.substr(0, slash + 1) + source;
+}
+
+static std::vector<size_t> source_dimensions(const std::string& filename,
+                                             const std::string& name)
+{
+  hid_t id = 0;
+  {
+    ErrorMessageSuppressor e;
+    id = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  }
+  if(id < 0){
+    std::ostringstream os;
+    os << "H5Fopen(" << filename << ", H5F_ACC_RDONLY) failed.";
+    throw EXCEPTION(os.str());
+  }
+
+  std::vector<size_t> rc;
+  hid_t dataset_id = H5Dopen(id, name.c_str(), H5P_DEFAULT);
+  if(dataset_id >= 0){
+    try{
+      Dataspace space(H5Dget_space(dataset_id));
+      rc = space.GetDimensions();
+    }
+    catch(...){
+      H5Dclose(dataset_id);
+      H5Fclose(id);
+      throw;
+    }
+    H5Dclose(dataset_id);
+  }
+  H5Fclose(id);
+
+  if(dataset_id < 0){
+    std::ostringstream os;
+    os << "Dataset " << name << " not found in " << filename << ".";
+    throw EXCEPTION(os.str());
+  }
+  return rc;
+}
+
+void File::WriteVirtualDataset(const std::string& path,
+                               const std::string& name,
+                               const std::vector<VirtualSource>& sources,
+                               hid_t datatype)
+{
+  if(sources.empty()){
+    throw EXCEPTION("WriteVirtualDataset needs at least one source.");
+  }
+
+  std::vector<std::vector<size_t> > source_dims(sources.size());
+  for(size_t i=0; i<sources.size(); ++i){
+    source_dims[i] = sources[i].dimensions.empty() ?
+      source_dimensions(resolve_source_filename(filename, sources[i].filename),
+                        sources[i].dataset) :
+      sources[i].dimensions;
+
+    if(source_dims[i].empty() ||
+       source_dims[i].size() != source_dims[0].size() ||
+       !std::equal(source_dims[i].begin() + 1, source_dims[i].end(),
+                   source_dims[0].begin() + 1))
+    {
+      std::ostringstream os;
+      os << "Shard " << sources[i].filename << ":" << sources[i].dataset
+         << " with dimensions " << vector_form<size_t>(source_dims[i])
+         << " does not match first shard "
+         << vector_form<size_t>(source_dims[0]) << ".";
+      throw EXCEPTION(os.str());
+    }
+  }
+
+  std::vector<size_t> dims(source_dims[0]);
+  dims[0] = 0;
+  for(size_t i=0; i<source_dims.size(); ++i){
+    dims[0] += source_dims[i][0];
+  }
+  Dataspace virtual_space(dims);
+
+  PropDatasetCreate p_dataset_create;
+  std::vector<size_t> start(dims.size(), 0u);
+  for(size_t i=0; i<sources.size(); ++i){
+    virtual_space.Select(Hyperslab(start, source_dims[i]));
+    Dataspace source_space(source_dims[i]);
+    p_dataset_create.AddVirtualMapping(virtual_space,
+                                       sources[i].filename,
+                                       sources[i].dataset,
+                                       source_space);
+    start[0] += source_dims[i][0];
+  }
+  H5CALL(H5Sselect_all, virtual_space.GetId());
+
+  Group* group = GetGroup(path);
+  Dataset dataset;
+  if(group){
+    dataset.Create(*group, name, p_dataset_create, virtual_space, datatype);
+  }
+  else{
+    dataset.Create(*this, name, p_dataset_create, virtual_space, datatype);
+  }
+}
+
+// ------------------------------------------------------------------- Attributes
+
+// Scoped handles used for attribute access.
+namespace
+{
+  class ObjectHandle {
+    public:
+      hid_t id;
+      ObjectHandle(hid_t file_id, const std::string& path)
+        : id(0)
+      {
+        const std::string p = path_is_root(path) ? "/" : path;
+        ErrorMessageSuppressor e;
+        if((id = H5Oopen(file_id, p.c_str(), H5P_DEFAULT)) < 0){
+          id = 0;
+          std::ostringstream os;
+          os << "H5Oopen(" << p << ") failed.";
+          throw EXCEPTION(os.str());
+        }
+      }
+      ~ObjectHandle(){
+        if(id){
+          H5Oclose(id);
+        }
+      }
+  };
+
+  class AttributeHandle {
+    public:
+      hid_t id;
+      AttributeHandle(hid_t object_id, const std::string& name)
+        : id(0)
+      {
+        if((id = H5Aopen(object_id, name.c_str(), H5P_DEFAULT)) < 0){
+          id = 0;
+          std::ostringstream os;
+          os << "H5Aopen(" << name << ") failed.";
+          throw EXCEPTION(os.str());
+        }
+      }
+      AttributeHandle(hid_t object_id,
+                      const std::string& name,
+                      hid_t type,
+                      const Dataspace& space)
+        : id(0)
+      {
+        if((id = H5Acreate2(object_id, name.c_str(), type, space.GetId(),
+                            H5P_DEFAULT, H5P_DEFAULT)) < 0)
+        {
+          id = 0;
+          std::ostringstream os;
+          os << "H5Acreate2(" << name << ") failed.";
+          throw EXCEPTION(os.str());
+        }
+      }
+      ~AttributeHandle(){
+        if(id){
+          H5Aclose(id);
+        }
+      }
+  };
+
+  class TypeHandle {
+    public:
+      hid_t id;
+      explicit TypeHandle(hid_t id_)
+        : id(id_)
+      {
+        if(id < 0){
+          id = 0;
+          throw EXCEPTION("Invalid datatype identifier.");
+        }
+      }
+      ~TypeHandle(){
+        if(id){
+          H5Tclose(id);
+        }
+      }
+  };
+}
+
+static void replace_attribute(hid_t object_id,
+                              const std::string& name,
+                              hid_t type,
+                              const Dataspace& space,
+                              const void* data)
+{
+  const htri_t exists = H5Aexists(object_id, name.c_str());
+  if(exists < 0){
+    std::ostringstream os;
+    os << "H5Aexists(" << name << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+  if(exists > 0){
+    H5CALL(H5Adelete, object_id, name.c_str());
+  }
+  AttributeHandle a(object_id, name, type, space);
+  H5CALL(H5Awrite, a.id, type, data);
+}
+
+void File::WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          hid_t memory_type,
+                          const std::vector<size_t>& dimensions,
+                          const void* data)
+{
+  ObjectHandle object(file_id, object_path);
+  if(dimensions.empty()){
+    Dataspace space(H5Screate(H5S_SCALAR));
+    replace_attribute(object.id, name, memory_type, space, data);
+  }
+  else{
+    Dataspace space(dimensions);
+    replace_attribute(object.id, name, memory_type, space, data);
+  }
+}
+
+void File::WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          const std::string& value)
+{
+  ObjectHandle object(file_id, object_path);
+  TypeHandle type(H5Tcopy(H5T_C_S1));
+  H5CALL(H5Tset_size, type.id, std::max<size_t>(value.size(), 1));
+  H5CALL(H5Tset_strpad, type.id, H5T_STR_NULLPAD);
+  Dataspace space(H5Screate(H5S_SCALAR));
+  // Keep the buffer at least one byte long for the empty string.
+  const std::string v = value.empty() ? std::string(1, '\0') : value;
+  replace_attribute(object.id, name, type.id, space, v.data());
+}
+
+bool File::HasAttribute(const std::string& object_path,
+                        const std::string& name)
+{
+  ObjectHandle object(file_id, object_path);
+  const htri_t exists = H5Aexists(object.id, name.c_str());
+  if(exists < 0){
+    std::ostringstream os;
+    os << "H5Aexists(" << name << ") failed.";
+    throw EXCEPTION(os.str());
+  }
+  return exists > 0;
+}
+
+std::vector<size_t> File::GetAttributeDimensions(const std::string& object_path,
+                                                 const std::string& name)
+{
+  ObjectHandle object(file_id, object_path);
+  AttributeHandle a(object.id, name);
+  Dataspace space(H5Aget_space(a.id));
+  return space.GetDimensions();
+}
+
+void File::ReadAttribute(const std::string& object_path,
+                         const std::string& name,
+                         hid_t memory_type,
+                         void* data)
+{
+  ObjectHandle object(file_id, object_path);
+  AttributeHandle a(object.id, name);
+  H5CALL(H5Aread, a.id, memory_type, data);
+}
+
+std::string File::ReadAttributeString(const std::string& object_path,
+                                      const std::string& name)
+{
+  ObjectHandle object(file_id, object_path);
+  AttributeHandle a(object.id, name);
+  TypeHandle type(H5Aget_type(a.id));
+  if(H5Tget_class(type.id) != H5T_STRING){
+    std::ostringstream os;
+    os << "Attribute " << object_path << ":" << name << " is not a string.";
+    throw EXCEPTION(os.str());
+  }
+
+  std::string rc;
+  if(H5Tis_variable_str(type.id) > 0){
+    TypeHandle memory_type(H5Tcopy(H5T_C_S1));
+    H5CALL(H5Tset_size, memory_type.id, H5T_VARIABLE);
+    char* s = NULL;
+    H5CALL(H5Aread, a.id, memory_type.id, &s);
+    if(s){
+      rc = s;
+      H5free_memory(s);
+    }
+  }
+  else{
+    std::vector<char> buf(H5Tget_size(type.id) + 1, '\0');
+    H5CALL(H5Aread, a.id, type.id, &buf[0]);
+    rc = std::string(&buf[0]);
+  }
+  return rc;
+}
+
 // HDF5File.cc ends here
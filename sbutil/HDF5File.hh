@@ -13,6 +13,7 @@
 #ifndef HDF5FILE_HH__F5D661C6_1D11_4C45_9F50_95B86C097EE1
 #define HDF5FILE_HH__F5D661C6_1D11_4C45_9F50_95B86C097EE1
 
+#include <map>
 #include <string>
 #include <vector>
 /*
@@ -57,13 +58,166 @@ typedef struct gsl_matrix_complex gsl_matrix_complex;
 
 namespace HDF5
 {
+  // Builder for HDF5 compound datatypes that mirror a C++ struct. See
+  // CompoundTraits below.
+  class CompoundType {
+    private:
+      hid_t type_id;
+
+      // make non-copyable
+      CompoundType(const CompoundType&);
+      CompoundType& operator=(const CompoundType&);
+
+    public:
+      // SIZE is sizeof() of the described struct.
+      CompoundType(size_t size);
+      ~CompoundType();
+      hid_t GetId() const {return type_id;}
+
+      // Add member NAME of HDF5 type MEMBER_TYPE at byte OFFSET, usually
+      // obtained with HOFFSET(struct, member).
+      CompoundType& Insert(const std::string& name,
+                           size_t offset,
+                           hid_t member_type);
+      // Add a fixed-size array member, e.g. uint8_t payload[64].
+      CompoundType& InsertArray(const std::string& name,
+                                size_t offset,
+                                hid_t base_type,
+                                const std::vector<size_t>& dims);
+
+      template<typename M>
+      CompoundType& Insert(const std::string& name, size_t offset);
+      template<typename M>
+      CompoundType& InsertArray(const std::string& name,
+                                size_t offset,
+                                size_t length);
+  };
+
+  // Specialize CompoundTraits for a struct to make it usable with the
+  // typed dataset and attribute functions below:
+  //
+  //   struct Record {
+  //     double time;
+  //     uint32_t source;
+  //     uint8_t payload[64];
+  //   };
+  //
+  //   namespace HDF5 {
+  //     template<> struct CompoundTraits<Record> {
+  //       static void Describe(CompoundType& t){
+  //         t.Insert<double>("time", HOFFSET(Record, time));
+  //         t.Insert<uint32_t>("source", HOFFSET(Record, source));
+  //         t.InsertArray<uint8_t>("payload", HOFFSET(Record, payload), 64);
+  //       }
+  //     };
+  //   }
+  //
+  // The compound type is created on first use and cached for the
+  // lifetime of the program.
+  template<typename T>
+  struct CompoundTraits;
+
+  // Compound type built from CompoundTraits<T>, see NativeType.
+  template<typename T>
+  class CachedCompoundType {
+    private:
+      CompoundType type;
+    public:
+      CachedCompoundType() : type(sizeof(T)) {CompoundTraits<T>::Describe(type);}
+      hid_t GetId() const {return type.GetId();}
+  };
+
+  // Native HDF5 type for T. Defined for the fundamental arithmetic
+  // types and for every struct with CompoundTraits.
+  template<typename T>
+  struct NativeType {
+      static hid_t Get(){
+        static CachedCompoundType<T> type;
+        return type.GetId();
+      }
+  };
+
+#define HDF5_NATIVE_TYPE(T, H)                        \
+  template<> struct NativeType<T> {                   \
+      static hid_t Get() {return (H);}                \
+  };
+
+  HDF5_NATIVE_TYPE(char, H5T_NATIVE_CHAR)
+  HDF5_NATIVE_TYPE(signed char, H5T_NATIVE_SCHAR)
+  HDF5_NATIVE_TYPE(unsigned char, H5T_NATIVE_UCHAR)
+  HDF5_NATIVE_TYPE(short, H5T_NATIVE_SHORT)
+  HDF5_NATIVE_TYPE(unsigned short, H5T_NATIVE_USHORT)
+  HDF5_NATIVE_TYPE(int, H5T_NATIVE_INT)
+  HDF5_NATIVE_TYPE(unsigned int, H5T_NATIVE_UINT)
+  HDF5_NATIVE_TYPE(long, H5T_NATIVE_LONG)
+  HDF5_NATIVE_TYPE(unsigned long, H5T_NATIVE_ULONG)
+  HDF5_NATIVE_TYPE(long long, H5T_NATIVE_LLONG)
+  HDF5_NATIVE_TYPE(unsigned long long, H5T_NATIVE_ULLONG)
+  HDF5_NATIVE_TYPE(float, H5T_NATIVE_FLOAT)
+  HDF5_NATIVE_TYPE(double, H5T_NATIVE_DOUBLE)
+
+#undef HDF5_NATIVE_TYPE
+
+  template<typename M>
+  CompoundType& CompoundType::Insert(const std::string& name, size_t offset){
+    return Insert(name, offset, NativeType<M>::Get());
+  }
+
+  template<typename M>
+  CompoundType& CompoundType::InsertArray(const std::string& name,
+                                          size_t offset,
+                                          size_t length)
+  {
+    return InsertArray(name, offset, NativeType<M>::Get(),
+                       std::vector<size_t>(1, length));
+  }
+
+  // Filters and chunk layout applied when File creates a dataset. The
+  // defaults reproduce the historical behavior of deflate level 9 with
+  // chunks of at most 64 elements along the first two dimensions.
+  struct WriteOptions {
+      // Deflate (gzip) level 0 -- 9. Negative disables compression.
+      int deflate_level;
+      // Byte shuffle filter, usually improves compression of numbers.
+      bool shuffle;
+      // Fletcher32 checksum for every chunk.
+      bool fletcher32;
+      // If nonzero, choose the chunk shape such that one chunk holds at
+      // most CHUNK_BYTES bytes. Otherwise use MAX_CHUNK_SIZE.
+      size_t chunk_bytes;
+      // Maximal chunk extent along the first two dimensions if
+      // CHUNK_BYTES is zero.
+      size_t max_chunk_size;
+
+      WriteOptions()
+        : deflate_level(9),
+          shuffle(false),
+          fletcher32(false),
+          chunk_bytes(0),
+          max_chunk_size(64)
+      {}
+
+      // True if any filter is enabled. Without filters, datasets of
+      // fixed size are stored contiguously.
+      bool HasFilters() const {
+        return deflate_level >= 0 || shuffle || fletcher32;
+      }
+
+      // No filters, contiguous layout.
+      static WriteOptions Uncompressed(){
+        WriteOptions o;
+        o.deflate_level = -1;
+        return o;
+      }
+  };
+
   class Properties {
     private:
-      const int identifier;
+      const hid_t identifier;
     protected:
       hid_t prop_id;
     public:
-      Properties(const int identifier_);
+      Properties(const hid_t identifier_);
       virtual ~Properties();
       hid_t GetId() const {return prop_id;}
   };
@@ -75,13 +229,69 @@ namespace HDF5
       void SetIntermediateCreate(bool create_intermediate_groups);
   };
 
+  class Dataspace;
   class PropDatasetCreate : public Properties {
     public:
       PropDatasetCreate();
       virtual ~PropDatasetCreate();
       void SetChunk(const std::vector<size_t>& dims,
                     size_t max_chunk_size);
+      // Set the chunk shape explicitly, one entry per dimension.
+      void SetChunkDimensions(const std::vector<hsize_t>& chunk_dims);
+      // Choose a chunk shape for a dataset with dimensions DIMS and
+      // elements of ELEMENT_SIZE bytes such that one chunk holds at most
+      // TARGET_BYTES. The slowest varying dimension is shrunk first, all
+      // the way to one element before the next one is touched, so that
+      // chunks stay contiguous in the fast ones.
+      void SetChunkBytes(const std::vector<size_t>& dims,
+                         size_t element_size,
+                         size_t target_bytes);
       void SetDeflate(int level);
+      void SetShuffle();
+      void SetFletcher32();
+
+      // Apply chunking and filters from OPTIONS. Does nothing if no
+      // filter is requested.
+      void Set(const WriteOptions& options,
+               const std::vector<size_t>& dims,
+               size_t element_size);
+      // Apply only the filters from OPTIONS, for datasets with a chunk
+      // shape set elsewhere.
+      void SetFilters(const WriteOptions& options);
+
+      // Map the current selection of VIRTUAL_SPACE to the selection of
+      // SOURCE_SPACE in dataset SOURCE_DATASET of file SOURCE_FILENAME,
+      // see H5Pset_virtual(3). Needs HDF5 >= 1.10.
+      void AddVirtualMapping(const Dataspace& virtual_space,
+                             const std::string& source_filename,
+                             const std::string& source_dataset,
+                             const Dataspace& source_space);
+  };
+
+  // Strided sub-block selection of a dataspace, see
+  // H5Sselect_hyperslab(3). COUNT blocks of BLOCK elements are selected
+  // along each dimension, starting at START and spaced by STRIDE. Empty
+  // STRIDE or BLOCK mean 1 in every dimension.
+  struct Hyperslab {
+      std::vector<hsize_t> start;
+      std::vector<hsize_t> stride;
+      std::vector<hsize_t> count;
+      std::vector<hsize_t> block;
+
+      Hyperslab() {}
+      // Contiguous sub-block of extent COUNT at START.
+      Hyperslab(const std::vector<size_t>& start_,
+                const std::vector<size_t>& count_);
+      // Every STRIDE-th element, COUNT times, starting at START.
+      Hyperslab(const std::vector<size_t>& start_,
+                const std::vector<size_t>& stride_,
+                const std::vector<size_t>& count_);
+
+      size_t Rank() const {return start.size();}
+      // Shape of the selected elements when packed densely.
+      std::vector<size_t> Dimensions() const;
+      // Number of selected elements.
+      size_t Size() const;
   };
 
   class Dataspace {
@@ -89,8 +299,20 @@ namespace HDF5
       hid_t dataspace_id;
     public:
       Dataspace(const std::vector<size_t>& dims);
+      // Extendible dataspace. Use H5S_UNLIMITED in MAX_DIMS for
+      // dimensions that can grow without bound.
+      Dataspace(const std::vector<size_t>& dims,
+                const std::vector<hsize_t>& max_dims);
+      // Take ownership of an existing dataspace, e.g. from H5Dget_space.
+      explicit Dataspace(hid_t dataspace_id_);
       virtual ~Dataspace();
       hid_t GetId() const {return dataspace_id;}
+
+      std::vector<size_t> GetDimensions() const;
+      // Number of currently selected elements.
+      size_t GetSelectedSize() const;
+      // Replace the current selection with SLAB.
+      void Select(const Hyperslab& slab);
   };
 
   class File;
@@ -126,40 +348,210 @@ namespace HDF5
       Dataset();
       virtual ~Dataset();
 
+      // DATATYPE is the type stored in the file.
       void Create(Group& group,
                   const std::string& name,
                   PropDatasetCreate& prop_dataset_create,
-                  Dataspace& dataspace);
+                  Dataspace& dataspace,
+                  hid_t datatype = H5T_IEEE_F64LE);
       void Create(File& file,
                   const std::string& name,
                   PropDatasetCreate& prop_dataset_create,
-                  Dataspace& dataspace);
+                  Dataspace& dataspace,
+                  hid_t datatype = H5T_IEEE_F64LE);
       void Write(const double* data);
       void Write(const int* data);
+      // Write the whole dataset from DATA holding elements of MEMORY_TYPE.
+      void Write(hid_t memory_type, const void* data);
+
+      // Open an existing dataset. Return false if it does not exist.
+      bool Open(Group& group, const std::string& name);
+      bool Open(File& file, const std::string& name);
+
+      std::vector<size_t> GetDimensions() const;
+
+      // Read the whole dataset, or only the elements selected by SLAB,
+      // into the densely packed buffer DATA. The caller must make sure
+      // that DATA holds enough elements.
+      void Read(double* data, const Hyperslab* slab = NULL);
+      void Read(int* data, const Hyperslab* slab = NULL);
+
+      // General form of Read. The elements selected by SLAB (or all)
+      // are scattered into DATA according to the selection in
+      // MEMORY_SPACE. Both selections must contain the same number of
+      // elements.
+      void Read(hid_t memory_type,
+                const Dataspace& memory_space,
+                void* data,
+                const Hyperslab* slab = NULL);
+      // Read into densely packed DATA holding elements of MEMORY_TYPE.
+      void Read(hid_t memory_type, void* data, const Hyperslab* slab = NULL);
+
     private:
       void Create(hid_t parent,
                   const std::string& name,
                   PropDatasetCreate& prop_dataset_create,
-                  Dataspace& dataspace);
+                  Dataspace& dataspace,
+                  hid_t datatype);
+      bool Open(hid_t parent, const std::string& name);
+  };
+
+
+  // Dataset whose first dimension is unlimited. Each row has the fixed
+  // shape ROW_DIMENSIONS (empty for a scalar time series), and rows are
+  // appended one at a time or in blocks. Every Append() extends the
+  // dataset on disk, so long time series never have to be buffered in
+  // memory until the end of a run.
+  //
+  // If the file was opened with append = true and the dataset already
+  // exists with matching row shape, new rows are added to the end. An
+  // existing dataset with a different datatype, or whose first
+  // dimension is not unlimited, is rejected with an Exception.
+  class AppendableDataset {
+    private:
+      hid_t dataset_id;
+      hid_t datatype;
+      std::vector<hsize_t> row_dims;
+      size_t row_size;
+      hsize_t rows;
+
+      // make non-copyable
+      AppendableDataset(const AppendableDataset&);
+      AppendableDataset& operator=(const AppendableDataset&);
+
+    public:
+      // If CHUNK_ROWS is zero, choose the number of rows per chunk such
+      // that a chunk holds about OPTIONS.chunk_bytes, or 64 kB if that
+      // is zero. Filters are taken from OPTIONS and are off by default.
+      AppendableDataset(File& file,
+                        const std::string& path,
+                        const std::string& name,
+                        const std::vector<size_t>& row_dimensions,
+                        hid_t datatype_ = H5T_IEEE_F64LE,
+                        size_t chunk_rows = 0,
+                        const WriteOptions& options = WriteOptions::Uncompressed());
+      ~AppendableDataset();
+
+      // Append N_ROWS consecutive rows stored in row-major order at BLOCK.
+      void Append(const double* block, size_t n_rows = 1);
+      void Append(const int* block, size_t n_rows = 1);
+
+      // Append as many rows as are contained in DATA. The size of DATA
+      // must be a multiple of the row size.
+      void Append(const std::vector<double>& data);
+      void Append(const std::vector<int>& data);
+
+      // Append N_ROWS rows of elements of MEMORY_TYPE.
+      void Append(hid_t memory_type, const void* block, size_t n_rows);
+
+      // Append records of type T, see NativeType and CompoundTraits.
+      // The dataset must have been created with NativeType<T>::Get().
+      template<typename T>
+      void AppendRecords(const T* block, size_t n_rows = 1){
+        Append(NativeType<T>::Get(), block, n_rows);
+      }
+
+      // Push appended rows out to the file on disk.
+      void Flush();
+
+      size_t GetRows() const {return rows;}
+      size_t GetRowSize() const {return row_size;}
+      hid_t GetId() const {return dataset_id;}
+  };
+
+  // One entry for the batched File::WriteDatasets* functions. DATA is
+  // not copied and must stay valid during the call.
+  template<typename T>
+  struct NamedData {
+      std::string name;
+      std::vector<size_t> dimensions;
+      const T* data;
+
+      NamedData(const std::string& name_,
+                const std::vector<size_t>& dimensions_,
+                const T* data_)
+        : name(name_), dimensions(dimensions_), data(data_)
+      {}
+  };
+
+  // One shard of a virtual dataset, see File::WriteVirtualDataset. If
+  // DIMENSIONS is empty, the shape is read from the source file.
+  struct VirtualSource {
+      std::string filename;
+      std::string dataset;
+      std::vector<size_t> dimensions;
+
+      VirtualSource(const std::string& filename_,
+                    const std::string& dataset_,
+                    const std::vector<size_t>& dimensions_ = std::vector<size_t>())
+        : filename(filename_), dataset(dataset_), dimensions(dimensions_)
+      {}
   };
 
+  // Name of shard INDEX for parallel output: BASE.00INDEX.h5. Each
+  // worker writes its own shard with File, without any locking, and the
+  // coordinator presents them as one dataset with WriteVirtualDataset.
+  std::string ShardFilename(const std::string& base, size_t index);
 
+  // File keeps the groups it has written to open and reuses property
+  // lists between writes, so that writing many small datasets into the
+  // same groups does not reopen the same metadata over and over. The
+  // caches are emptied by Close().
   class File {
     private:
       std::string filename;
       hid_t file_id;
-      size_t max_chunk_size;
+      WriteOptions write_options;
+
+      std::map<std::string, Group*> group_cache;
+      std::map<std::string, PropDatasetCreate*> prop_dataset_cache;
+      PropLinkCreate* prop_link_create;
+
+      // make non-copyable
+      File(const File&);
+      File& operator=(const File&);
+
+      void ClearCache();
+      PropDatasetCreate& GetPropDatasetCreate(const WriteOptions& options,
+                                              const std::vector<size_t>& dims,
+                                              size_t element_size);
 
     public:
       File(const std::string& filename_, bool append_);
       ~File();
       void Open(const std::string& filename_, bool append_);
       void Close();
+      // Write all buffered data to disk.
+      void Flush();
+
+      // Open the group at PATH, creating it and all intermediate
+      // groups if necessary. Does nothing for the root group.
+      void OpenOrCreateGroup(const std::string& path, Group& group);
+
+      // Cached version of OpenOrCreateGroup. The returned group stays
+      // open until Close(). Returns NULL for the root group.
+      Group* GetGroup(const std::string& path);
+
+      // HDF5 identifier of the group at PATH, or of the file for the
+      // root group. Creates the group if necessary.
+      hid_t GetGroupId(const std::string& path);
+
+      // Options used by all Write* functions that do not take explicit
+      // WriteOptions.
+      void SetWriteOptions(const WriteOptions& options){write_options = options;}
+      const WriteOptions& GetWriteOptions() const {return write_options;}
 
       void WriteDatasetDouble(const std::string& path,
                               const std::string& name,
                               const std::vector<size_t>& dimensions,
-                              const double* data);
+                              const double* data,
+                              const WriteOptions& options);
+      void WriteDatasetDouble(const std::string& path,
+                              const std::string& name,
+                              const std::vector<size_t>& dimensions,
+                              const double* data){
+        WriteDatasetDouble(path, name, dimensions, data, write_options);
+      }
       void WriteDatasetDouble(const std::string& path,
                               const std::string& name,
                               const std::vector<size_t>& dimensions,
@@ -170,7 +562,14 @@ namespace HDF5
       void WriteDatasetInt(const std::string& path,
                            const std::string& name,
                            const std::vector<size_t>& dimensions,
-                           const int* data);
+                           const int* data,
+                           const WriteOptions& options);
+      void WriteDatasetInt(const std::string& path,
+                           const std::string& name,
+                           const std::vector<size_t>& dimensions,
+                           const int* data){
+        WriteDatasetInt(path, name, dimensions, data, write_options);
+      }
       void WriteDatasetInt(const std::string& path,
                            const std::string& name,
                            const std::vector<size_t> dimensions,
@@ -178,6 +577,23 @@ namespace HDF5
         WriteDatasetInt(path, name, dimensions, &data[0]);
       }
 
+      // Write several datasets into the group at PATH, looking up the
+      // group and property lists only once.
+      void WriteDatasetsDouble(const std::string& path,
+                               const std::vector<NamedData<double> >& datasets,
+                               const WriteOptions& options);
+      void WriteDatasetsDouble(const std::string& path,
+                               const std::vector<NamedData<double> >& datasets){
+        WriteDatasetsDouble(path, datasets, write_options);
+      }
+      void WriteDatasetsInt(const std::string& path,
+                            const std::vector<NamedData<int> >& datasets,
+                            const WriteOptions& options);
+      void WriteDatasetsInt(const std::string& path,
+                            const std::vector<NamedData<int> >& datasets){
+        WriteDatasetsInt(path, datasets, write_options);
+      }
+
       void WriteVectorDouble(const std::string& path,
                              const std::string& name,
                              const std::vector<double>& data);
@@ -199,7 +615,197 @@ namespace HDF5
                           const std::string& name,
                           const gsl_matrix_complex* matrix);
 
+      // Write a dataset of elements with MEMORY_TYPE stored as FILE_TYPE.
+      void WriteDataset(const std::string& path,
+                        const std::string& name,
+                        const std::vector<size_t>& dimensions,
+                        hid_t file_type,
+                        hid_t memory_type,
+                        const void* data,
+                        const WriteOptions& options);
+
+      // Write an array of records of type T in a single H5Dwrite, see
+      // NativeType and CompoundTraits.
+      template<typename T>
+      void WriteDatasetCompound(const std::string& path,
+                                const std::string& name,
+                                const std::vector<size_t>& dimensions,
+                                const T* data,
+                                const WriteOptions& options){
+        WriteDataset(path, name, dimensions,
+                     NativeType<T>::Get(), NativeType<T>::Get(),
+                     data, options);
+      }
+      template<typename T>
+      void WriteDatasetCompound(const std::string& path,
+                                const std::string& name,
+                                const std::vector<T>& data){
+        WriteDatasetCompound(path, name, std::vector<size_t>(1, data.size()),
+                             data.empty() ? (const T*)NULL : &data[0],
+                             write_options);
+      }
+
+      // Create the virtual dataset NAME at PATH that concatenates the
+      // datasets in SOURCES along their first dimension. All sources
+      // must agree in the remaining dimensions. No data is copied; the
+      // sources are read through the virtual dataset when it is
+      // accessed. Relative source filenames are looked up relative to
+      // the directory of this file. Needs HDF5 >= 1.10.
+      void WriteVirtualDataset(const std::string& path,
+                               const std::string& name,
+                               const std::vector<VirtualSource>& sources,
+                               hid_t datatype = H5T_IEEE_F64LE);
+
+      // Attach attribute NAME to the group or dataset at OBJECT_PATH,
+      // replacing an existing attribute of the same name. The object
+      // must exist. Elements of MEMORY_TYPE are stored with the same
+      // type in the file.
+      void WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          hid_t memory_type,
+                          const std::vector<size_t>& dimensions,
+                          const void* data);
+      void WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          const std::string& value);
+      void WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          const char* value){
+        WriteAttribute(object_path, name, std::string(value));
+      }
+      template<typename T>
+      void WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          const T& value){
+        WriteAttribute(object_path, name, NativeType<T>::Get(),
+                       std::vector<size_t>(), &value);
+      }
+      template<typename T>
+      void WriteAttribute(const std::string& object_path,
+                          const std::string& name,
+                          const std::vector<T>& values){
+        WriteAttribute(object_path, name, NativeType<T>::Get(),
+                       std::vector<size_t>(1, values.size()),
+                       values.empty() ? (const T*)NULL : &values[0]);
+      }
+
+      bool HasAttribute(const std::string& object_path,
+                        const std::string& name);
+      std::vector<size_t> GetAttributeDimensions(const std::string& object_path,
+                                                 const std::string& name);
+      // Read the attribute into DATA, which must hold enough elements
+      // of MEMORY_TYPE.
+      void ReadAttribute(const std::string& object_path,
+                         const std::string& name,
+                         hid_t memory_type,
+                         void* data);
+      std::string ReadAttributeString(const std::string& object_path,
+                                      const std::string& name);
+      template<typename T>
+      T ReadAttribute(const std::string& object_path,
+                      const std::string& name){
+        T rc;
+        ReadAttribute(object_path, name, NativeType<T>::Get(), &rc);
+        return rc;
+      }
+      template<typename T>
+      void ReadAttribute(const std::string& object_path,
+                         const std::string& name,
+                         std::vector<T>& values){
+        const std::vector<size_t> d = GetAttributeDimensions(object_path, name);
+        size_t n = 1;
+        for(size_t i=0; i<d.size(); ++i){
+          n *= d[i];
+        }
+        values.resize(n);
+        if(n > 0){
+          ReadAttribute(object_path, name, NativeType<T>::Get(), &values[0]);
+        }
+      }
+
+      // Read counterparts of the Write* functions. If SLAB is given,
+      // only the selected elements are read, packed densely in
+      // row-major order.
+      //
+      // Pointer versions expect DATA to be large enough. The
+      // std::vector versions resize DATA as needed. The GSL versions
+      // read directly into the storage of V or MATRIX, honoring vector
+      // stride and matrix tda, and require its shape to match the
+      // selection.
+      std::vector<size_t> GetDatasetDimensions(const std::string& path,
+                                               const std::string& name);
+
+      void ReadDatasetDouble(const std::string& path,
+                             const std::string& name,
+                             double* data,
+                             const Hyperslab* slab = NULL);
+      void ReadDatasetDouble(const std::string& path,
+                             const std::string& name,
+                             std::vector<double>& data,
+                             const Hyperslab* slab = NULL);
+      void ReadDatasetInt(const std::string& path,
+                          const std::string& name,
+                          int* data,
+                          const Hyperslab* slab = NULL);
+      void ReadDatasetInt(const std::string& path,
+                          const std::string& name,
+                          std::vector<int>& data,
+                          const Hyperslab* slab = NULL);
+
+      void ReadGSLVector(const std::string& path,
+                         const std::string& name,
+                         gsl_vector* v,
+                         const Hyperslab* slab = NULL);
+      void ReadGSLVector(const std::string& path,
+                         const std::string& name,
+                         gsl_vector_complex* v,
+                         const Hyperslab* slab = NULL);
+      void ReadGSLMatrix(const std::string& path,
+                         const std::string& name,
+                         gsl_matrix* matrix,
+                         const Hyperslab* slab = NULL);
+      void ReadGSLMatrix(const std::string& path,
+                         const std::string& name,
+                         gsl_matrix_complex* matrix,
+                         const Hyperslab* slab = NULL);
+
+      // Read records of type T written with WriteDatasetCompound. No
+      // reassembly is needed, HDF5 converts directly into DATA.
+      template<typename T>
+      void ReadDatasetCompound(const std::string& path,
+                               const std::string& name,
+                               std::vector<T>& data,
+                               const Hyperslab* slab = NULL){
+        Dataset dataset;
+        OpenDataset(path, name, dataset);
+        size_t n = 1;
+        if(slab){
+          n = slab->Size();
+        }
+        else{
+          const std::vector<size_t> d = dataset.GetDimensions();
+          for(size_t i=0; i<d.size(); ++i){
+            n *= d[i];
+          }
+        }
+        data.resize(n);
+        if(n > 0){
+          dataset.Read(NativeType<T>::Get(), &data[0], slab);
+        }
+      }
+
       hid_t GetId() const {return file_id;}
+
+    private:
+      void OpenDataset(const std::string& path,
+                       const std::string& name,
+                       Dataset& dataset);
+      void ReadStrided(const std::string& path,
+                       const std::string& name,
+                       double* data,
+                       const std::vector<size_t>& memory_dims,
+                       const Hyperslab& memory_slab,
+                       const Hyperslab* slab);
   };
 
 }
@@ -1,9 +1,9 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-27 14:24:09 sb"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       IPUtilities.cc
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
  */
 
@@ -25,9 +25,18 @@
 #include <ifaddrs.h>
 
 std::string StringFromIPAddress(uint32_t address_in_host_byte_order) {
+  // inet_ntop(3) instead of inet_ntoa(3), which returns a pointer to a
+  // static buffer and is not thread-safe.
   struct in_addr in;
   in.s_addr = htonl(address_in_host_byte_order);
-  return std::string(inet_ntoa(in));
+  char buf[INET_ADDRSTRLEN];
+  if(inet_ntop(AF_INET, &in, buf, sizeof(buf)) == NULL){
+    std::ostringstream os;
+    os << "inet_ntop() failed\n"
+       << strerror(errno) << "\n";
+    throw EXCEPTION(os.str());
+  }
+  return std::string(buf);
 }
 
 uint32_t IPAddressFromString(const std::string& address){
@@ -50,11 +59,104 @@ uint32_t HostToNetworkByteOrder(uint32_t x){
 }
 
 uint16_t NetworkToHostByteOrder(uint16_t x){
-  return ntohl(x);
+  return ntohs(x);
 }
 
 uint32_t NetworkToHostByteOrder(uint32_t x){
-  return ntohs(x);
+  return ntohl(x);
+}
+
+// ------------------------------------------------------------------- IPAddress
+
+static const uint8_t V4_MAPPED_PREFIX[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+
+IPAddress::IPAddress()
+  : family(IPV4)
+{
+  memset(&a, 0, sizeof(a));
+}
+
+IPAddress::IPAddress(uint32_t address_in_host_byte_order)
+  : family(IPV4)
+{
+  memset(&a, 0, sizeof(a));
+  a.v4 = address_in_host_byte_order;
+}
+
+IPAddress::IPAddress(const std::string& address)
+  : family(IPV4)
+{
+  memset(&a, 0, sizeof(a));
+  struct in_addr in;
+  if(inet_pton(AF_INET, address.c_str(), &in) == 1){
+    a.v4 = ntohl(in.s_addr);
+  }
+  else if(inet_pton(AF_INET6, address.c_str(), a.v6) == 1){
+    family = IPV6;
+  }
+  else{
+    std::ostringstream os;
+    os << "\"" << address << "\" is not an IPV4 or IPV6 address.";
+    throw EXCEPTION(os.str());
+  }
+}
+
+IPAddress::IPAddress(const uint8_t* v6_network_order)
+  : family(IPV6)
+{
+  memcpy(a.v6, v6_network_order, sizeof(a.v6));
+}
+
+bool IPAddress::IsIPV4Mapped() const {
+  return family == IPV6 && memcmp(a.v6, V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX)) == 0;
+}
+
+uint32_t IPAddress::GetIPV4() const {
+  if(family == IPV4){
+    return a.v4;
+  }
+  if(IsIPV4Mapped()){
+    return ((uint32_t)a.v6[12] << 24) | ((uint32_t)a.v6[13] << 16)
+      | ((uint32_t)a.v6[14] << 8) | a.v6[15];
+  }
+  return 0;
+}
+
+void IPAddress::GetIPV6(uint8_t* v6_network_order) const {
+  if(family == IPV6){
+    memcpy(v6_network_order, a.v6, sizeof(a.v6));
+    return;
+  }
+  memcpy(v6_network_order, V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX));
+  for(size_t i=0; i<4; ++i){
+    v6_network_order[12 + i] = static_cast<uint8_t>(a.v4 >> (24 - 8 * i));
+  }
+}
+
+std::string IPAddress::ToString() const {
+  if(family == IPV4){
+    return StringFromIPAddress(a.v4);
+  }
+  char buf[INET6_ADDRSTRLEN];
+  if(inet_ntop(AF_INET6, a.v6, buf, sizeof(buf)) == NULL){
+    std::ostringstream os;
+    os << "inet_ntop() failed\n"
+       << strerror(errno) << "\n";
+    throw EXCEPTION(os.str());
+  }
+  return std::string(buf);
+}
+
+bool IPAddress::operator==(const IPAddress& x) const {
+  if(family != x.family){
+    return false;
+  }
+  return family == IPV4 ? a.v4 == x.a.v4 : memcmp(a.v6, x.a.v6, sizeof(a.v6)) == 0;
+}
+
+std::ostream& operator<<(std::ostream& out, const IPAddress& x){
+  out << x.ToString();
+  return out;
 }
 
 std::string GetLocalhostName(){
@@ -82,6 +184,36 @@ bool MatchSubnet(uint32_t address, uint32_t subnet, uint32_t netmask){
   return (address & netmask) == subnet;
 }
 
+bool MatchSubnet(const IPAddress& address,
+                 const IPAddress& subnet,
+                 unsigned int prefix_length)
+{
+  if(address.GetFamily() != subnet.GetFamily()){
+    return false;
+  }
+  if(address.IsIPV4()){
+    if(prefix_length == 0){
+      return true;
+    }
+    const uint32_t netmask =
+      prefix_length >= 32 ? 0xffffffffu : ~(0xffffffffu >> prefix_length);
+    return (address.GetIPV4() & netmask) == (subnet.GetIPV4() & netmask);
+  }
+  uint8_t x[16];
+  uint8_t y[16];
+  address.GetIPV6(x);
+  subnet.GetIPV6(y);
+  for(size_t i=0; i<16 && prefix_length > 0; ++i){
+    const unsigned int bits = prefix_length >= 8 ? 8 : prefix_length;
+    const uint8_t mask = static_cast<uint8_t>(0xff00 >> bits);
+    if((x[i] & mask) != (y[i] & mask)){
+      return false;
+    }
+    prefix_length -= bits;
+  }
+  return true;
+}
+
 uint32_t GetLocalhostIPAddress(uint32_t subnet, uint32_t netmask){
   struct ifaddrs* as;
   if(getifaddrs(&as)){
@@ -92,7 +224,7 @@ uint32_t GetLocalhostIPAddress(uint32_t subnet, uint32_t netmask){
   }
   uint32_t address_host_order = 0;
   for(struct ifaddrs* a=as; a; a=a->ifa_next){
-    if(a->ifa_addr->sa_family == AF_INET){
+    if(a->ifa_addr && a->ifa_addr->sa_family == AF_INET){
       struct sockaddr_in* b = (sockaddr_in*)a->ifa_addr;
       uint32_t c = ntohl(b->sin_addr.s_addr);
       //std::cout << StringFromIPAddress(c) << std::endl;
@@ -114,6 +246,43 @@ uint32_t GetLocalhostIPAddress(uint32_t subnet, uint32_t netmask){
   return address_host_order;
 }
 
+IPAddress GetLocalhostIPAddress(const IPAddress& subnet,
+                                unsigned int prefix_length)
+{
+  struct ifaddrs* as;
+  if(getifaddrs(&as)){
+    std::ostringstream os;
+    os << "getifaddrs() failed.\n"
+       << strerror(errno) << "\n";
+    throw EXCEPTION(os.str());
+  }
+  IPAddress rc;
+  bool found = false;
+  for(struct ifaddrs* a=as; a && !found; a=a->ifa_next){
+    if(a->ifa_addr == NULL){
+      continue;
+    }
+    if(a->ifa_addr->sa_family == AF_INET && subnet.IsIPV4()){
+      const struct sockaddr_in* b = (const sockaddr_in*)a->ifa_addr;
+      rc = IPAddress((uint32_t)ntohl(b->sin_addr.s_addr));
+      found = MatchSubnet(rc, subnet, prefix_length);
+    }
+    else if(a->ifa_addr->sa_family == AF_INET6 && subnet.IsIPV6()){
+      const struct sockaddr_in6* b = (const sockaddr_in6*)a->ifa_addr;
+      rc = IPAddress(b->sin6_addr.s6_addr);
+      found = MatchSubnet(rc, subnet, prefix_length);
+    }
+  }
+  freeifaddrs(as);
+
+  if(!found){
+    std::ostringstream os;
+    os << "No IP address matches subnet " << subnet << "/" << prefix_length;
+    throw EXCEPTION(os.str());
+  }
+  return rc;
+}
+
 
 
 
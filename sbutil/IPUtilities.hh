@@ -1,9 +1,14 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-27 14:25:11 sb"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       IPUtilities.hh
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
+
+  IPV4 addresses are passed around as 32-bit numbers in host byte
+  order, which is what the UDP classes use internally. IPAddress holds
+  either an IPV4 or an IPV6 address, parsed once, for code that has to
+  handle both families.
 
  */
 
@@ -17,7 +22,7 @@
 #include <sbutil/OutputManipulator.hh>
 
 // Convert 32-bit number in host byte order to IPV4 address string
-// representation.
+// representation. Thread-safe.
 std::string StringFromIPAddress(uint32_t address_in_host_byte_order);
 
 // Convert IPV4 address string representation to 32-bit number in host
@@ -34,16 +39,77 @@ uint16_t NetworkToHostByteOrder(uint16_t x);
 uint32_t NetworkToHostByteOrder(uint32_t x);
 
 
+// IPV4 or IPV6 address. IPV4 addresses are stored as a number in host
+// byte order, IPV6 addresses as 16 bytes in network byte order.
+class IPAddress {
+  public:
+    typedef enum {
+      IPV4,
+      IPV6
+    } family_t;
+
+  private:
+    family_t family;
+    union {
+        uint32_t v4;
+        uint8_t v6[16];
+    } a;
+
+  public:
+    // 0.0.0.0
+    IPAddress();
+    IPAddress(uint32_t address_in_host_byte_order);
+    // Parse ADDRESS in dotted decimal or IPV6 notation. Throws if
+    // ADDRESS is neither.
+    explicit IPAddress(const std::string& address);
+    // 16 bytes of IPV6 address in network byte order.
+    explicit IPAddress(const uint8_t* v6_network_order);
+
+    family_t GetFamily() const {return family;}
+    bool IsIPV4() const {return family == IPV4;}
+    bool IsIPV6() const {return family == IPV6;}
+
+    // True for IPV6 addresses of the form ::ffff:a.b.c.d, which a
+    // dual-stack socket reports for IPV4 peers.
+    bool IsIPV4Mapped() const;
+
+    // The IPV4 address in host byte order, also for IPV4-mapped IPV6
+    // addresses. 0 for other IPV6 addresses.
+    uint32_t GetIPV4() const;
+
+    // The IPV6 address in network byte order. IPV4 addresses are
+    // returned in IPV4-mapped form.
+    void GetIPV6(uint8_t* v6_network_order) const;
+
+    std::string ToString() const;
+
+    bool operator==(const IPAddress& x) const;
+    bool operator!=(const IPAddress& x) const {return !operator==(x);}
+};
+
+std::ostream& operator<<(std::ostream& out, const IPAddress& x);
+
 // Get string representation of localhost using gethostname(3)
 std::string GetLocalhostName();
 
 // Match IPV4 address with given subnet and netmask, all in host byte order
 bool MatchSubnet(uint32_t address, uint32_t subnet, uint32_t netmask);
 
+// Match ADDRESS with the first PREFIX_LENGTH bits of SUBNET. Addresses
+// of different families never match.
+bool MatchSubnet(const IPAddress& address,
+                 const IPAddress& subnet,
+                 unsigned int prefix_length);
+
 // Look through the list of IPV4 addresses returned by getifaddrs(3)
 // and return the first one matching subnet and netmask.
 uint32_t GetLocalhostIPAddress(uint32_t subnet, uint32_t netmask);
 
+// Same for either family, e.g. with SUBNET fd00:: and PREFIX_LENGTH 8
+// to find the unique local IPV6 address of this host.
+IPAddress GetLocalhostIPAddress(const IPAddress& subnet,
+                                unsigned int prefix_length);
+
 
 
 #endif // IPUTILITIES_HH__215922F6_CEA4_4A1C_AB00_D7696EDECB8F
@@ -0,0 +1,197 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 11:48:22 sb"
+
+/*
+  file       ImageView.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Typed, non-owning view of a grayscale pixel buffer in row-major
+  order, such as the frames exposed by Tiff and TiffStack, plus bulk
+  reductions over it.
+
+  Accessors do not check bounds. Check regions of interest once with
+  ImageView::roi(), which returns an empty view if the region does not
+  fit, and then run the reductions over the result. The reductions
+  walk each row through a plain pointer with a local accumulator, so
+  that the compiler can vectorize the inner loops.
+
+ */
+
+
+#ifndef IMAGEVIEW_HH__0E599253_895E_429B_BF42_446671506683
+#define IMAGEVIEW_HH__0E599253_895E_429B_BF42_446671506683
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+template <typename T>
+class ImageView {
+  public:
+    typedef T value_type;
+
+    ImageView()
+      : data(NULL), width(0), height(0), stride(0) {}
+
+    // View WIDTH x HEIGHT pixels at DATA_. Consecutive rows are
+    // STRIDE_ pixels apart, 0 means WIDTH.
+    ImageView(const T* data_, size_t width_, size_t height_, size_t stride_ = 0)
+      : data(data_), width(width_), height(height_),
+        stride(stride_ ? stride_ : width_) {}
+
+    bool empty() const {return data == NULL || width == 0 || height == 0;}
+    size_t get_width() const {return width;}
+    size_t get_height() const {return height;}
+    size_t get_area() const {return width*height;}
+    size_t get_stride() const {return stride;}  // Row pitch in pixels.
+    bool is_contiguous() const {return stride == width;}
+
+    const T* get_data() const {return data;}
+    const T* row(size_t y) const {return data + y*stride;}
+    const T* row_end(size_t y) const {return row(y) + width;}
+    T operator()(size_t x, size_t y) const {return data[y*stride + x];}
+
+    // Sub-view of W x H pixels at (X, Y). Empty if the region does not
+    // lie completely inside this view.
+    ImageView roi(size_t x, size_t y, size_t w, size_t h) const {
+      if(x + w > width || y + h > height || x + w < x || y + h < y){
+        return ImageView();
+      }
+      return ImageView(row(y) + x, w, h, stride);
+    }
+
+  private:
+    const T* data;
+    size_t width;
+    size_t height;
+    size_t stride;
+};
+
+namespace image_detail
+{
+  // Widest integer that cannot overflow when summing up to
+  // ROW_CHUNK values of type T. Summing into 32 bit lanes keeps the
+  // vectorized loops twice as wide as with 64 bit lanes.
+  template <typename T> struct row_accumulator {typedef T type;};
+  template <> struct row_accumulator<uint8_t> {typedef uint32_t type;};
+  template <> struct row_accumulator<uint16_t> {typedef uint32_t type;};
+  template <> struct row_accumulator<int16_t> {typedef int32_t type;};
+  template <> struct row_accumulator<float> {typedef double type;};
+
+  template <typename T> struct total_accumulator {typedef T type;};
+  template <> struct total_accumulator<uint8_t> {typedef uint64_t type;};
+  template <> struct total_accumulator<uint16_t> {typedef uint64_t type;};
+  template <> struct total_accumulator<int16_t> {typedef int64_t type;};
+  template <> struct total_accumulator<float> {typedef double type;};
+
+  // 65535 * 65536 < 2^32
+  static const size_t ROW_CHUNK = 65536;
+
+  template <typename T>
+  inline typename total_accumulator<T>::type
+  sum_row(const T* p, size_t n){
+    typedef typename row_accumulator<T>::type acc_t;
+    typename total_accumulator<T>::type total = 0;
+    while(n > 0){
+      const size_t m = n < ROW_CHUNK ? n : ROW_CHUNK;
+      acc_t s = 0;
+      for(size_t i=0; i<m; ++i){
+        s += p[i];
+      }
+      total += s;
+      p += m;
+      n -= m;
+    }
+    return total;
+  }
+}
+
+// Sum of all pixels in V.
+template <typename T>
+typename image_detail::total_accumulator<T>::type
+image_sum(const ImageView<T>& v){
+  typename image_detail::total_accumulator<T>::type total = 0;
+  if(v.is_contiguous()){
+    return image_detail::sum_row(v.get_data(), v.get_area());
+  }
+  for(size_t y=0; y<v.get_height(); ++y){
+    total += image_detail::sum_row(v.row(y), v.get_width());
+  }
+  return total;
+}
+
+// Sum of the W x H pixels at (X, Y) in V. Return 0 if the region does
+// not fit.
+template <typename T>
+typename image_detail::total_accumulator<T>::type
+image_roi_sum(const ImageView<T>& v, size_t x, size_t y, size_t w, size_t h){
+  return image_sum(v.roi(x, y, w, h));
+}
+
+// Sum of the pixels in V after subtracting the constant BACKGROUND
+// from each of them.
+template <typename T>
+double image_sum_minus_background(const ImageView<T>& v, double background){
+  return static_cast<double>(image_sum(v)) - background * v.get_area();
+}
+
+// RESULT = V - BACKGROUND pixel by pixel, in row-major order without
+// padding. V and BACKGROUND must have the same dimensions. Use a
+// signed or floating point U to keep negative values.
+template <typename T, typename U>
+void image_subtract(const ImageView<T>& v, const ImageView<T>& background,
+                    std::vector<U>& result)
+{
+  const size_t w = v.get_width();
+  result.resize(v.get_area());
+  U* out = result.empty() ? NULL : &result[0];
+  for(size_t y=0; y<v.get_height(); ++y, out += w){
+    const T* a = v.row(y);
+    const T* b = background.row(y);
+    for(size_t x=0; x<w; ++x){
+      out[x] = static_cast<U>(a[x]) - static_cast<U>(b[x]);
+    }
+  }
+}
+
+// RESULT = V - BACKGROUND for a constant BACKGROUND.
+template <typename T, typename U>
+void image_subtract(const ImageView<T>& v, U background, std::vector<U>& result){
+  const size_t w = v.get_width();
+  result.resize(v.get_area());
+  U* out = result.empty() ? NULL : &result[0];
+  for(size_t y=0; y<v.get_height(); ++y, out += w){
+    const T* a = v.row(y);
+    for(size_t x=0; x<w; ++x){
+      out[x] = static_cast<U>(a[x]) - background;
+    }
+  }
+}
+
+// Sum of each row of V, RESULT has get_height() entries.
+template <typename T, typename U>
+void image_project_rows(const ImageView<T>& v, std::vector<U>& result){
+  result.resize(v.get_height());
+  for(size_t y=0; y<v.get_height(); ++y){
+    result[y] = static_cast<U>(image_detail::sum_row(v.row(y), v.get_width()));
+  }
+}
+
+// Sum of each column of V, RESULT has get_width() entries. Walks the
+// image row by row to stay cache friendly.
+template <typename T, typename U>
+void image_project_columns(const ImageView<T>& v, std::vector<U>& result){
+  const size_t w = v.get_width();
+  result.assign(w, U(0));
+  U* out = result.empty() ? NULL : &result[0];
+  for(size_t y=0; y<v.get_height(); ++y){
+    const T* a = v.row(y);
+    for(size_t x=0; x<w; ++x){
+      out[x] += a[x];
+    }
+  }
+}
+
+#endif // IMAGEVIEW_HH__0E599253_895E_429B_BF42_446671506683
+
+// ImageView.hh ends here
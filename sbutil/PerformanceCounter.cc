@@ -1,9 +1,9 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2014-02-23 12:00:50 sb"
+// Time-stamp: "2026-10-19 18:40:02 sb"
 
 /*
   file       PerformanceCounter.cc
-  copyright  (c) Sebastian Blatt 2014
+  copyright  (c) Sebastian Blatt 2014 -- 2026
 
  */
 
@@ -11,60 +11,234 @@
 #include <sbutil/PerformanceCounter.hh>
 
 #include <cmath>
-
-PerformanceCounter::PerformanceCounter()
-  : frequency(0),
-    counter_start(0)
-{
+#include <ctime>
+#include <chrono>
 
 #if SBUTIL_IS_PLATFORM_WINDOWS
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif // SBUTIL_IS_PLATFORM_WINDOWS
 
-  LARGE_INTEGER tmp;
-  QueryPerformanceFrequency(&tmp);
-  frequency = ((double)tmp.QuadPart);
-
-  QueryPerformanceCounter(&tmp);
-  counter_start = tmp.QuadPart;
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define PERFORMANCECOUNTER_HAVE_TSC 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#include <cpuid.h>
+#endif
+#else
+#define PERFORMANCECOUNTER_HAVE_TSC 0
+#endif
 
+namespace
+{
+  const int64_t NANOSECONDS = 1000000000;
+
+#if SBUTIL_IS_PLATFORM_POSIX
+  inline int64_t read_clock(clockid_t id){
+    struct timespec t;
+    clock_gettime(id, &t);
+    return static_cast<int64_t>(t.tv_sec) * NANOSECONDS + t.tv_nsec;
+  }
+#endif
+
+  // Nanoseconds, or QueryPerformanceCounter ticks on Windows.
+  inline int64_t read_wall_clock(){
+#if SBUTIL_IS_PLATFORM_WINDOWS
+    LARGE_INTEGER tmp;
+    QueryPerformanceCounter(&tmp);
+    return tmp.QuadPart;
+#elif SBUTIL_IS_PLATFORM_LINUX
+    return read_clock(CLOCK_MONOTONIC_RAW);
 #else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+  }
 
-  // Good reference for timing
-  //
-  //   https://github.com/bittorrent/libutp/blob/master/utp_utils.cpp
+  double wall_clock_seconds_per_tick(){
+#if SBUTIL_IS_PLATFORM_WINDOWS
+    LARGE_INTEGER tmp;
+    QueryPerformanceFrequency(&tmp);
+    return 1.0 / tmp.QuadPart;
+#else
+    return 1.0 / NANOSECONDS;
+#endif
+  }
 
-  frequency = CLOCKS_PER_SEC;
-  counter_start = std::clock();
-#endif // SBUTIL_IS_PLATFORM_WINDOWS
+#if SBUTIL_IS_PLATFORM_WINDOWS
+  // FILETIME counts in units of 100 ns.
+  inline int64_t filetime_sum(const FILETIME& a, const FILETIME& b){
+    ULARGE_INTEGER x, y;
+    x.LowPart = a.dwLowDateTime;
+    x.HighPart = a.dwHighDateTime;
+    y.LowPart = b.dwLowDateTime;
+    y.HighPart = b.dwHighDateTime;
+    return static_cast<int64_t>(x.QuadPart + y.QuadPart);
+  }
+#endif
+
+  // Nanoseconds, or 100 ns units on Windows.
+  inline int64_t read_cpu_time(bool thread){
+#if SBUTIL_IS_PLATFORM_WINDOWS
+    FILETIME creation, exit, kernel, user;
+    if(thread){
+      GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user);
+    }
+    else{
+      GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    }
+    return filetime_sum(kernel, user);
+#else
+    return read_clock(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID);
+#endif
+  }
 
-  time_start = (unsigned long)time(0);
+  inline double cpu_time_seconds_per_tick(){
+#if SBUTIL_IS_PLATFORM_WINDOWS
+    return 1e-7;
+#else
+    return 1.0 / NANOSECONDS;
+#endif
+  }
+
+#if PERFORMANCECOUNTER_HAVE_TSC
+  inline int64_t read_tsc(){
+    // rdtscp waits for earlier instructions to finish, so the section
+    // being timed is not reordered past the read.
+    unsigned int aux;
+    return static_cast<int64_t>(__rdtscp(&aux));
+  }
+
+  // The TSC only measures time if it ticks at a constant rate in all
+  // power states, and rdtscp must be there.
+  bool have_invariant_tsc(){
+#if defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 0x80000000);
+    if((unsigned int)r[0] < 0x80000007){
+      return false;
+    }
+    __cpuid(r, 0x80000001);
+    const bool rdtscp = (r[3] >> 27) & 1;
+    __cpuid(r, 0x80000007);
+    return rdtscp && ((r[3] >> 8) & 1);
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if(__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) == 0 || eax < 0x80000007){
+      return false;
+    }
+    __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    const bool rdtscp = (edx >> 27) & 1;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return rdtscp && ((edx >> 8) & 1);
+#endif
+  }
+
+  // Count TSC ticks over about 10 ms of wall clock time.
+  double calibrate_tsc(){
+    if(!have_invariant_tsc()){
+      return 0.0;
+    }
+    const double wall = wall_clock_seconds_per_tick();
+    const int64_t w0 = read_wall_clock();
+    const int64_t c0 = read_tsc();
+    int64_t w1 = w0;
+    while((w1 - w0) * wall < 10e-3){
+      w1 = read_wall_clock();
+    }
+    const int64_t c1 = read_tsc();
+    return (c1 - c0) / ((w1 - w0) * wall);
+  }
+#endif // PERFORMANCECOUNTER_HAVE_TSC
 }
 
-double PerformanceCounter::GetRelativeTime(){
-#if SBUTIL_IS_PLATFORM_WINDOWS
+double PerformanceCounter::GetCycleFrequency(){
+#if PERFORMANCECOUNTER_HAVE_TSC
+  // Thread-safe initialization since C++11.
+  static const double frequency = calibrate_tsc();
+  return frequency;
+#else
+  return 0.0;
+#endif
+}
 
-  LARGE_INTEGER tmp;
-  QueryPerformanceCounter(&tmp);
-  return ((double)(tmp.QuadPart - counter_start)) / frequency;
+PerformanceCounter::PerformanceCounter(source_t source_)
+  : source(source_),
+    seconds_per_tick(0),
+    counter_start(0),
+    time_start(0)
+{
+  switch(source){
+    case CYCLE_COUNTER:
+      {
+        const double f = GetCycleFrequency();
+        if(f > 0){
+          seconds_per_tick = 1.0 / f;
+          break;
+        }
+        source = WALL_CLOCK;
+      }
+      // fall through
+    case WALL_CLOCK:
+      seconds_per_tick = wall_clock_seconds_per_tick();
+      break;
+    case PROCESS_CPU_TIME:
+    case THREAD_CPU_TIME:
+      seconds_per_tick = cpu_time_seconds_per_tick();
+      break;
+  }
+  Reset();
+}
 
+int64_t PerformanceCounter::GetTicks() const {
+  switch(source){
+    case WALL_CLOCK:
+      return read_wall_clock();
+    case PROCESS_CPU_TIME:
+      return read_cpu_time(false);
+    case THREAD_CPU_TIME:
+      return read_cpu_time(true);
+    case CYCLE_COUNTER:
+#if PERFORMANCECOUNTER_HAVE_TSC
+      return read_tsc();
 #else
+      break;
+#endif
+  }
+  return 0;
+}
 
-  return ((double)(std::clock() - counter_start)) / frequency;
+void PerformanceCounter::Reset(){
+  time_start = (unsigned long)time(0);
+  counter_start = GetTicks();
+}
 
-#endif // SBUTIL_IS_PLATFORM_WINDOWS
+double PerformanceCounter::GetRelativeTime() const {
+  return (GetTicks() - counter_start) * seconds_per_tick;
+}
+
+int64_t PerformanceCounter::GetRelativeNanoseconds() const {
+  const int64_t dt = GetTicks() - counter_start;
+  if(seconds_per_tick == 1.0 / NANOSECONDS){
+    return dt;
+  }
+  return static_cast<int64_t>(dt * (seconds_per_tick * NANOSECONDS));
 }
 
-double PerformanceCounter::GetAbsoluteTime(){
+double PerformanceCounter::GetAbsoluteTime() const {
   double rel = GetRelativeTime();
   return (double)time_start + rel;
 }
 
-unsigned long PerformanceCounter::GetAbsoluteTimeRounded(){
+unsigned long PerformanceCounter::GetAbsoluteTimeRounded() const {
   // Use floor instead of round to ensure that we are never in the future.
   double rel = floor(GetRelativeTime());
   return time_start + (unsigned long)rel;
 }
 
-unsigned long PerformanceCounter::GetStartTime(){
+unsigned long PerformanceCounter::GetStartTime() const {
   return (unsigned long)time_start;
 }
 
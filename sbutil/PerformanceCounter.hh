@@ -1,19 +1,30 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2014-02-23 12:13:23 sb"
+// Time-stamp: "2026-10-19 18:40:02 sb"
 
 /*
   file       PerformanceCounter.hh
-  copyright  (c) Sebastian Blatt 2014
-
-  General purpose code timing. Wraps QueryPerformanceCounter on
-  Windows and std::clock otherwise. Not sure how much to trust the
-  accuracy of these counters for long intervals.
-
-  FIXME: Try to find a relative interval accuracy estimate dtau/tau of
-  std::clock. Once we have reached dtau/tau * tau = 1s, switch to
-  time() instead. Also should take into account that clock_t overflows
-  around 36 minutes. There is also a microsecond gettimeofday
-  function. Assume that std::clock is significantly faster to execute.
+  copyright  (c) Sebastian Blatt 2014 -- 2026
+
+  General purpose code timing. A counter measures the time elapsed
+  since it was constructed or Reset() on one of these clocks:
+
+    WALL_CLOCK        monotonic real time: CLOCK_MONOTONIC_RAW on
+                      Linux, QueryPerformanceCounter on Windows,
+                      std::chrono::steady_clock otherwise. Not affected
+                      by NTP adjustments or changes of the system time.
+    PROCESS_CPU_TIME  CPU time used by all threads of the process.
+    THREAD_CPU_TIME   CPU time used by the calling thread. Construct,
+                      Reset() and read such a counter on the same
+                      thread.
+    CYCLE_COUNTER     x86 time stamp counter read with rdtscp,
+                      converted to seconds with a frequency calibrated
+                      once per process against WALL_CLOCK. Cheapest to
+                      read, for timing short sections. Only used if the
+                      CPU reports an invariant TSC, falls back to
+                      WALL_CLOCK otherwise, see GetSource().
+
+  Counts are kept as 64-bit integers, so none of the counters wrap
+  around in practice.
 
   See these articles
 
@@ -27,36 +38,52 @@
 #define PERFORMANCECOUNTER_HH__C9D42287_FFDA_45F5_9571_BF7F86011F8F
 
 #include <sbutil/Platform.hh>
+#include <stdint.h>
 
-#if SBUTIL_IS_PLATFORM_WINDOWS
+class PerformanceCounter {
+  public:
+    typedef enum {
+      WALL_CLOCK,
+      PROCESS_CPU_TIME,
+      THREAD_CPU_TIME,
+      CYCLE_COUNTER
+    } source_t;
 
-#define WIN32_LEAN_AND_MEAN
-#include <windows.h>
+  private:
+    source_t source;
+    double seconds_per_tick;
+    int64_t counter_start;
+    unsigned long time_start;
 
-#else
+    int64_t GetTicks() const;
 
-#include <ctime>
-#include <sys/time.h>
+  public:
+    PerformanceCounter(source_t source_ = WALL_CLOCK);
 
-#endif //SBUTIL_IS_PLATFORM_WINDOWS
+    // The clock actually used, which differs from the requested one
+    // only if CYCLE_COUNTER is not available.
+    source_t GetSource() const {return source;}
 
+    // Restart the interval, and the absolute time reference.
+    void Reset();
 
-class PerformanceCounter {
-  private:
-    double frequency;
- #if SBUTIL_IS_PLATFORM_WINDOWS
-    __int64 counter_start;
- #else
-    clock_t counter_start;
- #endif // SBUTIL_IS_PLATFORM_WINDOWS
-    unsigned long time_start;
+    // Seconds since construction or the last Reset().
+    double GetRelativeTime() const;
 
-  public:
-    PerformanceCounter();
-    double GetRelativeTime();
-    double GetAbsoluteTime();
-    unsigned long GetAbsoluteTimeRounded();
-    unsigned long GetStartTime();
+    // Nanoseconds since construction or the last Reset().
+    int64_t GetRelativeNanoseconds() const;
+
+    // Seconds since the UNIX Epoch, extrapolated from the wall time at
+    // construction with the relative time. Only meaningful for
+    // WALL_CLOCK and CYCLE_COUNTER.
+    double GetAbsoluteTime() const;
+    unsigned long GetAbsoluteTimeRounded() const;
+    unsigned long GetStartTime() const;
+
+    // Calibrated frequency of the time stamp counter in Hz, 0 if
+    // CYCLE_COUNTER is not available. The calibration takes about 10 ms
+    // on first use.
+    static double GetCycleFrequency();
 };
 
 #endif // PERFORMANCECOUNTER_HH__C9D42287_FFDA_45F5_9571_BF7F86011F8F
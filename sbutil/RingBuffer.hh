@@ -0,0 +1,277 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 15:31:40 sb"
+
+/*
+  file       RingBuffer.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Bounded lock-free queues for handing work between threads, and a
+  pool of fixed-size packet buffers addressed by index.
+
+    SPSCRing<T>  one producer thread, one consumer thread
+    MPSCRing<T>  any number of producer threads, one consumer thread
+    PacketPool   preallocated buffers, acquired by one thread and
+                 released by any thread
+
+  The capacity is rounded up to a power of two. Push and Pop never
+  block or allocate; they return false (or a short count for the
+  batch versions) if the ring is full or empty. Producer and consumer
+  indices are kept on separate cache lines by padding rather than by
+  alignas, so the classes are not over-aligned and can be created
+  with new like any other.
+
+  To pass packets from a receive thread to a worker without locks or
+  allocation, keep the payload in a PacketPool and pass the indices
+  through an SPSCRing<uint32_t>.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef RINGBUFFER_HH__35118E96_FE65_4A4F_A191_51CEBA01F837
+#define RINGBUFFER_HH__35118E96_FE65_4A4F_A191_51CEBA01F837
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+#ifndef SBUTIL_CACHE_LINE_SIZE
+#define SBUTIL_CACHE_LINE_SIZE 64
+#endif
+
+namespace ring_detail
+{
+  inline size_t round_up_power_of_two(size_t n){
+    size_t p = 1;
+    while(p < n){
+      p <<= 1;
+    }
+    return p;
+  }
+}
+
+template<typename T>
+class SPSCRing {
+  private:
+    // Each group starts a full cache line after the start of the last
+    // field of the previous one, which keeps them on separate lines
+    // for any placement of the ring, since there is no alignas.
+    char pad_front[SBUTIL_CACHE_LINE_SIZE];
+    // Consumer side.
+    std::atomic<size_t> head;
+    size_t cached_tail;
+    char pad_head[SBUTIL_CACHE_LINE_SIZE - sizeof(size_t)];
+    // Producer side.
+    std::atomic<size_t> tail;
+    size_t cached_head;
+    char pad_tail[SBUTIL_CACHE_LINE_SIZE - sizeof(size_t)];
+    // Shared, read-only after construction.
+    size_t mask;
+    std::vector<T> slots;
+
+    // make non-copyable
+    SPSCRing(const SPSCRing&);
+    SPSCRing& operator=(const SPSCRing&);
+
+  public:
+    SPSCRing(size_t capacity)
+      : pad_front(), head(0), cached_tail(0), pad_head(),
+        tail(0), cached_head(0), pad_tail(),
+        mask(ring_detail::round_up_power_of_two(capacity) - 1),
+        slots(mask + 1)
+    {}
+
+    size_t GetCapacity() const {return mask + 1;}
+
+    // Number of queued items. Only a snapshot if called while the
+    // other side is active.
+    size_t GetSize() const {
+      return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    // Producer only.
+    bool Push(const T& x) {return PushBatch(&x, 1) == 1;}
+
+    // Producer only. Queue up to N items and return how many fit.
+    size_t PushBatch(const T* items, size_t n){
+      const size_t t = tail.load(std::memory_order_relaxed);
+      size_t free = GetCapacity() - (t - cached_head);
+      if(free < n){
+        cached_head = head.load(std::memory_order_acquire);
+        free = GetCapacity() - (t - cached_head);
+      }
+      if(n > free){
+        n = free;
+      }
+      for(size_t i=0; i<n; ++i){
+        slots[(t + i) & mask] = items[i];
+      }
+      tail.store(t + n, std::memory_order_release);
+      return n;
+    }
+
+    // Consumer only.
+    bool Pop(T& x) {return PopBatch(&x, 1) == 1;}
+
+    // Consumer only. Dequeue up to N items into ITEMS and return how
+    // many there were.
+    size_t PopBatch(T* items, size_t n){
+      const size_t h = head.load(std::memory_order_relaxed);
+      size_t available = cached_tail - h;
+      if(available < n){
+        cached_tail = tail.load(std::memory_order_acquire);
+        available = cached_tail - h;
+      }
+      if(n > available){
+        n = available;
+      }
+      for(size_t i=0; i<n; ++i){
+        items[i] = slots[(h + i) & mask];
+      }
+      head.store(h + n, std::memory_order_release);
+      return n;
+    }
+};
+
+// Bounded multi-producer queue after D. Vyukov: each slot carries a
+// sequence number that tells producers and the consumer whose turn it
+// is, so producers only contend on the tail index.
+template<typename T>
+class MPSCRing {
+  private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    char pad_front[SBUTIL_CACHE_LINE_SIZE];
+    // Consumer side.
+    size_t head;
+    char pad_head[SBUTIL_CACHE_LINE_SIZE - sizeof(size_t)];
+    // Producer side.
+    std::atomic<size_t> tail;
+    char pad_tail[SBUTIL_CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+    // Shared.
+    size_t mask;
+    std::vector<Slot> slots;
+
+    // make non-copyable
+    MPSCRing(const MPSCRing&);
+    MPSCRing& operator=(const MPSCRing&);
+
+  public:
+    MPSCRing(size_t capacity)
+      : pad_front(), head(0), pad_head(), tail(0), pad_tail(),
+        mask(ring_detail::round_up_power_of_two(capacity) - 1),
+        slots(mask + 1)
+    {
+      for(size_t i=0; i<=mask; ++i){
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+      }
+    }
+
+    size_t GetCapacity() const {return mask + 1;}
+
+    // Any thread.
+    bool Push(const T& x) {return PushBatch(&x, 1) == 1;}
+
+    // Any thread. Queue all N items, or none if they do not fit at the
+    // moment. Return N or 0.
+    size_t PushBatch(const T* items, size_t n){
+      if(n == 0 || n > GetCapacity()){
+        return 0;
+      }
+      size_t t = tail.load(std::memory_order_relaxed);
+      while(true){
+        // The consumer frees slots in order, so if the last slot of
+        // the range is free, all of them are.
+        const Slot& last = slots[(t + n - 1) & mask];
+        const size_t seq = last.sequence.load(std::memory_order_acquire);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)(t + n - 1);
+        if(diff == 0){
+          if(tail.compare_exchange_weak(t, t + n, std::memory_order_relaxed)){
+            break;
+          }
+        }
+        else if(diff < 0){ // full
+          return 0;
+        }
+        else{ // another producer got there first
+          t = tail.load(std::memory_order_relaxed);
+        }
+      }
+      for(size_t i=0; i<n; ++i){
+        Slot& s = slots[(t + i) & mask];
+        s.value = items[i];
+        s.sequence.store(t + i + 1, std::memory_order_release);
+      }
+      return n;
+    }
+
+    // Consumer only.
+    bool Pop(T& x) {return PopBatch(&x, 1) == 1;}
+
+    // Consumer only. Dequeue up to N items into ITEMS and return how
+    // many there were. Stops at the first slot a producer has claimed
+    // but not yet filled.
+    size_t PopBatch(T* items, size_t n){
+      size_t i = 0;
+      for(; i<n; ++i){
+        Slot& s = slots[head & mask];
+        if(s.sequence.load(std::memory_order_acquire) != head + 1){
+          break;
+        }
+        items[i] = s.value;
+        s.sequence.store(head + mask + 1, std::memory_order_release);
+        ++head;
+      }
+      return i;
+    }
+};
+
+// N_BUFFERS buffers of BUFFER_SIZE bytes in one allocation. Acquire()
+// must always be called from the same thread. Release() may be called
+// from any thread.
+class PacketPool {
+  private:
+    size_t buffer_size;
+    std::vector<uint8_t> storage;
+    std::vector<size_t> lengths;
+    MPSCRing<uint32_t> free_list;
+
+    // make non-copyable
+    PacketPool(const PacketPool&);
+    PacketPool& operator=(const PacketPool&);
+
+  public:
+    PacketPool(size_t n_buffers, size_t buffer_size_)
+      : buffer_size(buffer_size_),
+        storage(n_buffers * buffer_size_),
+        lengths(n_buffers, 0),
+        free_list(n_buffers)
+    {
+      for(uint32_t i=0; i<n_buffers; ++i){
+        free_list.Push(i);
+      }
+    }
+
+    size_t GetNumberOfBuffers() const {return lengths.size();}
+    size_t GetBufferSize() const {return buffer_size;}
+
+    // Take a free buffer. Return false if all are in use.
+    bool Acquire(uint32_t& index) {return free_list.Pop(index);}
+    void Release(uint32_t index) {free_list.Push(index);}
+
+    uint8_t* GetBuffer(uint32_t index) {return &storage[index * buffer_size];}
+    const uint8_t* GetBuffer(uint32_t index) const {return &storage[index * buffer_size];}
+
+    // Payload length of buffer INDEX, maintained by the caller.
+    size_t GetLength(uint32_t index) const {return lengths[index];}
+    void SetLength(uint32_t index, size_t length) {lengths[index] = length;}
+};
+
+#endif // RINGBUFFER_HH__35118E96_FE65_4A4F_A191_51CEBA01F837
+
+// RingBuffer.hh ends here
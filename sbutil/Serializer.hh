@@ -0,0 +1,242 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 15:06:12 sb"
+
+/*
+  file       Serializer.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Bounds-checked encoding of arithmetic fields in network byte order
+  (most significant byte first) into a caller-provided buffer, and
+  decoding in place from a received buffer.
+
+  Packet types list their fields once in a member template
+
+    struct Telemetry : public TypedUDPPacket<Telemetry> {
+        uint32_t sequence;
+        double value;
+        int16_t samples[4];
+
+        template<typename Visitor>
+        void Fields(Visitor& v) {v(sequence); v(value); v(samples);}
+    };
+
+  and TypedUDPPacket derives Serialize(), Deserialize(), and the
+  zero-copy EncodeTo()/DecodeFrom() from this list. Byte order is
+  handled with shifts, which the compiler turns into a single load
+  and byte swap where needed, so there is no run time check of the
+  host byte order.
+
+  Writers and readers do not throw. Running past the end of the
+  buffer sets an error flag and turns all further accesses into
+  no-ops.
+
+*/
+
+
+#ifndef SERIALIZER_HH__1F37C301_4FDB_4A63_9672_6635CFD75BF1
+#define SERIALIZER_HH__1F37C301_4FDB_4A63_9672_6635CFD75BF1
+
+#include <cstring>
+#include <stdint.h>
+#include <sbutil/UDPPacket.hh>
+#include <sbutil/Exception.hh>
+
+namespace serializer_detail
+{
+  // Unsigned integer of the same size as T, used to move the bits of
+  // floating point and signed fields.
+  template<size_t N> struct bits;
+  template<> struct bits<1> {typedef uint8_t type;};
+  template<> struct bits<2> {typedef uint16_t type;};
+  template<> struct bits<4> {typedef uint32_t type;};
+  template<> struct bits<8> {typedef uint64_t type;};
+
+  template<typename T>
+  inline void store(uint8_t* p, T x){
+    typedef typename bits<sizeof(T)>::type U;
+    U u;
+    memcpy(&u, &x, sizeof(T));
+    for(size_t i=0; i<sizeof(T); ++i){
+      p[i] = static_cast<uint8_t>(u >> (8 * (sizeof(T) - 1 - i)));
+    }
+  }
+
+  template<typename T>
+  inline T load(const uint8_t* p){
+    typedef typename bits<sizeof(T)>::type U;
+    U u = 0;
+    for(size_t i=0; i<sizeof(T); ++i){
+      u = static_cast<U>((u << 8) | p[i]);
+    }
+    T x;
+    memcpy(&x, &u, sizeof(T));
+    return x;
+  }
+}
+
+class ByteWriter {
+  private:
+    uint8_t* buffer;
+    size_t capacity;
+    size_t position;
+    bool failed;
+
+  public:
+    ByteWriter(uint8_t* buffer_, size_t capacity_)
+      : buffer(buffer_), capacity(capacity_), position(0), failed(false) {}
+
+    template<typename T>
+    void Put(T x){
+      if(failed || capacity - position < sizeof(T)){
+        failed = true;
+        return;
+      }
+      serializer_detail::store(buffer + position, x);
+      position += sizeof(T);
+    }
+
+    void PutBytes(const void* data, size_t length){
+      if(failed || capacity - position < length){
+        failed = true;
+        return;
+      }
+      memcpy(buffer + position, data, length);
+      position += length;
+    }
+
+    // Visitor interface for TypedUDPPacket::Fields.
+    template<typename T>
+    void operator()(const T& x) {Put(x);}
+    template<typename T, size_t N>
+    void operator()(const T (&x)[N]) {for(size_t i=0; i<N; ++i) Put(x[i]);}
+
+    size_t GetSize() const {return position;}
+    bool Ok() const {return !failed;}
+};
+
+class ByteReader {
+  private:
+    const uint8_t* buffer;
+    size_t length;
+    size_t position;
+    bool failed;
+
+  public:
+    ByteReader(const uint8_t* buffer_, size_t length_)
+      : buffer(buffer_), length(length_), position(0), failed(false) {}
+
+    template<typename T>
+    void Get(T& x){
+      if(failed || length - position < sizeof(T)){
+        failed = true;
+        return;
+      }
+      x = serializer_detail::load<T>(buffer + position);
+      position += sizeof(T);
+    }
+
+    template<typename T>
+    T Get(){
+      T x = T();
+      Get(x);
+      return x;
+    }
+
+    // Pointer to the next LENGTH_ bytes without copying, or NULL if
+    // the buffer is too short.
+    const uint8_t* GetBytes(size_t length_){
+      if(failed || length - position < length_){
+        failed = true;
+        return NULL;
+      }
+      const uint8_t* p = buffer + position;
+      position += length_;
+      return p;
+    }
+
+    // Visitor interface for TypedUDPPacket::Fields.
+    template<typename T>
+    void operator()(T& x) {Get(x);}
+    template<typename T, size_t N>
+    void operator()(T (&x)[N]) {for(size_t i=0; i<N; ++i) Get(x[i]);}
+
+    size_t GetPosition() const {return position;}
+    size_t GetRemaining() const {return length - position;}
+    bool Ok() const {return !failed;}
+};
+
+// Adds up the encoded size of a field list.
+class ByteCounter {
+  private:
+    size_t size;
+
+  public:
+    ByteCounter() : size(0) {}
+
+    template<typename T>
+    void operator()(const T&) {size += sizeof(T);}
+    template<typename T, size_t N>
+    void operator()(const T (&)[N]) {size += N * sizeof(T);}
+
+    size_t GetSize() const {return size;}
+};
+
+// CRTP base for packets with a fixed field list, see above. DERIVED
+// must provide template<typename Visitor> void Fields(Visitor&).
+template<typename Derived>
+class TypedUDPPacket : public UDPPacket {
+  private:
+    Derived& Self() {return static_cast<Derived&>(*this);}
+
+  public:
+    // Encoded size in bytes.
+    size_t GetEncodedSize() {
+      ByteCounter c;
+      Self().Fields(c);
+      return c.GetSize();
+    }
+
+    // Encode the fields into BUFFER. Return the number of bytes
+    // written, or 0 if CAPACITY is too small.
+    size_t EncodeTo(uint8_t* buffer, size_t capacity) {
+      ByteWriter w(buffer, capacity);
+      Self().Fields(w);
+      return w.Ok() ? w.GetSize() : 0;
+    }
+
+    // Decode the fields from BUFFER, e.g. straight out of a
+    // UDPReceiveBatch, without touching UDPPacket::data. Return false
+    // if LENGTH is too short.
+    bool DecodeFrom(const uint8_t* buffer, size_t length) {
+      ByteReader r(buffer, length);
+      Self().Fields(r);
+      return r.Ok();
+    }
+
+    // UDPPacket hooks. Serialize encodes into the data member, reusing
+    // its allocation.
+    bool Serialize(bool nothrow = false) {
+      data.resize(GetEncodedSize());
+      if(data.empty() || EncodeTo(&data[0], data.size()) == data.size()){
+        return true;
+      }
+      if(nothrow){
+        return false;
+      }
+      throw EXCEPTION("TypedUDPPacket::Serialize: encoding failed.");
+    }
+
+    bool Deserialize(bool nothrow = false) {
+      if(DecodeFrom(data.empty() ? NULL : &data[0], data.size())){
+        return true;
+      }
+      if(nothrow){
+        return false;
+      }
+      throw EXCEPTION("TypedUDPPacket::Deserialize: packet too short.");
+    }
+};
+
+#endif // SERIALIZER_HH__1F37C301_4FDB_4A63_9672_6635CFD75BF1
+
+// Serializer.hh ends here
@@ -1,9 +1,9 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2019-12-10 17:45:10 sb"
+// Time-stamp: "2026-10-19 11:52:40 sb"
 
 /*
   file       Tiff.cc
-  copyright  (c) Sebastian Blatt 2009 -- 2019
+  copyright  (c) Sebastian Blatt 2009 -- 2026
 
  */
 
@@ -13,6 +13,7 @@
 #include <memory>
 #include <iostream>
 #include <sstream>
+#include <cstring>
 #include <tiffio.h>
 
 
@@ -138,12 +139,16 @@ unsigned short Tiff::get(size_t x, size_t y) const {
               << width-1 << "," << height-1 << ")" << std::endl;
     return 0;
   }
+  // libtiff decodes samples to host byte order
   const unsigned char* address = buffer.const_get(y*width+x);
-  unsigned short rc = *address;
   if(buffer.get_chunk()>1){
-    rc |= (*(address+1)) << 8;
+    // memcpy instead of a cast keeps this within strict aliasing, and
+    // compiles to a single load.
+    uint16_t v;
+    memcpy(&v, address, sizeof(v));
+    return v;
   }
-  return rc;
+  return *address;
 }
 
 size_t Tiff::get_number_of_frames(const std::string& f) {
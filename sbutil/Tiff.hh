@@ -1,15 +1,16 @@
 /* -*- mode: C++ -*- */
-/* Time-stamp: "2014-02-26 14:14:06 sb" */
+/* Time-stamp: "2026-10-19 11:52:40 sb" */
 
 /*
   file       Tiff.hh
-  copyright  (c) Sebastian Blatt 2009 -- 2014
+  copyright  (c) Sebastian Blatt 2009 -- 2026
 
   Wrapper class to support loading 8 bit and 16 bit grayscale TIFF
   files via libtiff. Load file as respective number of bits, but
   expose unsigned short datatype to the outside world only.
 
-  Might be a bit slow, since get() becomes more expensive.
+  Might be a bit slow, since get() becomes more expensive. For bulk
+  access, use get_view() and the reductions in ImageView.hh.
 
 */
 
@@ -19,6 +20,7 @@
 
 #include <string>
 #include <sbutil/VariableBuffer.hh>
+#include <sbutil/ImageView.hh>
 
 class Tiff {
   private:
@@ -42,6 +44,18 @@ class Tiff {
     // Get image amplitude at coordinates X and Y.
     unsigned short get(size_t x, size_t y) const;
 
+    // Typed view of the whole image for bulk access, see
+    // ImageView.hh. T must be uint8_t for 8 bit and uint16_t for 16 bit
+    // images, otherwise the view is empty.
+    template <typename T>
+    ImageView<T> get_view() const {
+      if(sizeof(T)*8 != bits_per_sample){
+        return ImageView<T>();
+      }
+      return ImageView<T>(static_cast<const T*>(buffer.const_expose()),
+                          width, height);
+    }
+
     // Determine the number of frames = number of TIFF directories in
     // TIFF file F. Return 0 on error.
     static size_t get_number_of_frames(const std::string& f);
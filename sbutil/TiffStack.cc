@@ -0,0 +1,440 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 11:31:05 sb"
+
+/*
+  file       TiffStack.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/Platform.hh>
+#include <sbutil/TiffStack.hh>
+#include <sbutil/Exception.hh>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <tiffio.h>
+
+#if SBUTIL_IS_PLATFORM_POSIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+TiffStack::TiffStack()
+  : filename(),
+    image(NULL),
+    fd(-1),
+    map(NULL),
+    map_size(0),
+    frames()
+{}
+
+TiffStack::~TiffStack(){
+  close_file();
+}
+
+size_t TiffStack::get_size(size_t n) const {
+  const frame_info& fi = frames[n];
+  return fi.width * fi.height * (fi.bits_per_sample / 8);
+}
+
+bool TiffStack::map_file(){
+#if SBUTIL_IS_PLATFORM_POSIX
+  if((fd = open(filename.c_str(), O_RDONLY)) == -1){
+    return false;
+  }
+  struct stat st;
+  if(fstat(fd, &st) == -1 || st.st_size == 0){
+    close(fd);
+    fd = -1;
+    return false;
+  }
+  void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if(p == MAP_FAILED){
+    close(fd);
+    fd = -1;
+    return false;
+  }
+  map = static_cast<const unsigned char*>(p);
+  map_size = st.st_size;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void TiffStack::unmap_file(){
+#if SBUTIL_IS_PLATFORM_POSIX
+  if(map){
+    munmap(const_cast<unsigned char*>(map), map_size);
+  }
+  if(fd != -1){
+    close(fd);
+  }
+#endif
+  map = NULL;
+  map_size = 0;
+  fd = -1;
+}
+
+bool TiffStack::open_file(const std::string& f){
+  close_file();
+  filename = f;
+
+  try{
+    if((image = TIFFOpen(f.c_str(), "r")) == NULL){
+      throw EXCEPTION("Could not open image.");
+    }
+
+    // Without a mapping, every frame is decoded on demand.
+    map_file();
+
+    do{
+      index_frame();
+    } while(TIFFReadDirectory(image));
+  }
+  catch(Exception& e){
+    std::cerr << "TiffStack::open_file(" << f << ", frame "
+              << frames.size() << ") : " << e << std::endl;
+    close_file();
+    return false;
+  }
+  return true;
+}
+
+void TiffStack::close_file(){
+  if(image){
+    TIFFClose(image);
+    image = NULL;
+  }
+  unmap_file();
+  frames.clear();
+  filename.clear();
+}
+
+void TiffStack::index_frame(){
+  frame_info fi;
+  fi.offset = TIFFCurrentDirOffset(image);
+  fi.mapped = NULL;
+
+  uint32_t width = 0, height = 0;
+  uint16_t bps = 0, spp = 1, compression = COMPRESSION_NONE;
+  if(TIFFGetField(image, TIFFTAG_IMAGEWIDTH, &width) == 0 ||
+     TIFFGetField(image, TIFFTAG_IMAGELENGTH, &height) == 0)
+  {
+    throw EXCEPTION("Image dimensions undefined.");
+  }
+  if(width == 0 || height == 0){
+    throw EXCEPTION("Empty image.");
+  }
+  if(TIFFGetField(image, TIFFTAG_BITSPERSAMPLE, &bps) == 0){
+    throw EXCEPTION("Undefined bits per sample.");
+  }
+  if(!(bps == 16 || bps == 8)){
+    throw EXCEPTION("Only 8 or 16 bits per sample are supported.");
+  }
+  TIFFGetFieldDefaulted(image, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  if(spp != 1){
+    throw EXCEPTION("Only grayscale images are supported.");
+  }
+  if(TIFFIsTiled(image)){
+    throw EXCEPTION("Tiled images are not supported.");
+  }
+  TIFFGetFieldDefaulted(image, TIFFTAG_COMPRESSION, &compression);
+
+  fi.width = width;
+  fi.height = height;
+  fi.bits_per_sample = bps;
+
+  // Zero-copy is possible if the strips are stored back to back,
+  // uncompressed, in host byte order, and aligned for the pixel type.
+  if(map && compression == COMPRESSION_NONE &&
+     (bps == 8 || !TIFFIsByteSwapped(image)))
+  {
+    uint64_t* offsets = NULL;
+    uint64_t* byte_counts = NULL;
+    if(TIFFGetField(image, TIFFTAG_STRIPOFFSETS, &offsets) &&
+       TIFFGetField(image, TIFFTAG_STRIPBYTECOUNTS, &byte_counts))
+    {
+      const size_t n_strips = TIFFNumberOfStrips(image);
+      const uint64_t size = (uint64_t)width * height * (bps / 8);
+      uint64_t total = 0;
+      bool contiguous = n_strips > 0;
+      for(size_t s=0; s<n_strips && contiguous; ++s){
+        contiguous = offsets[s] == offsets[0] + total;
+        total += byte_counts[s];
+      }
+      if(contiguous && total >= size &&
+         offsets[0] + size <= map_size &&
+         offsets[0] % (bps / 8) == 0)
+      {
+        fi.mapped = map + offsets[0];
+      }
+    }
+  }
+
+  frames.push_back(fi);
+}
+
+void TiffStack::decode_frame(size_t n){
+  frame_info& fi = frames[n];
+
+  // Jump straight to the directory instead of walking the chain.
+  if(TIFFSetSubDirectory(image, fi.offset) == 0){
+    std::ostringstream os;
+    os << "Failed switching to frame " << n << ".";
+    throw EXCEPTION(os.str());
+  }
+
+  const size_t size = get_size(n);
+  fi.decoded.resize(size);
+
+  const uint32_t n_strips = TIFFNumberOfStrips(image);
+  size_t offset = 0;
+  for(uint32_t s=0; s<n_strips && offset < size; ++s){
+    tmsize_t res = TIFFReadEncodedStrip(image, s, &fi.decoded[offset],
+                                        size - offset);
+    if(res == -1){
+      fi.decoded.clear();
+      std::ostringstream os;
+      os << "Error reading strip " << s << " of frame " << n << ".";
+      throw EXCEPTION(os.str());
+    }
+    offset += res;
+  }
+}
+
+const void* TiffStack::get_frame(size_t n){
+  if(n >= frames.size()){
+    std::cerr << "TiffStack::get_frame : frame " << n << " out of bounds ("
+              << frames.size() << " frames)" << std::endl;
+    return NULL;
+  }
+
+  frame_info& fi = frames[n];
+  if(fi.mapped){
+    return fi.mapped;
+  }
+  if(fi.decoded.empty()){
+    try{
+      decode_frame(n);
+    }
+    catch(Exception& e){
+      std::cerr << "TiffStack::get_frame : " << e << std::endl;
+      return NULL;
+    }
+  }
+  return &fi.decoded[0];
+}
+
+void TiffStack::release_frame(size_t n){
+  if(n < frames.size()){
+    std::vector<unsigned char>().swap(frames[n].decoded);
+  }
+}
+
+// ------------------------------------------------------------ parallel loading
+
+namespace
+{
+  // Shared state of the threads in TiffStack::load_frames.
+  struct load_job {
+      std::string filename;
+      std::vector<uint64_t> offsets;          // directory offset per frame
+      std::vector<const unsigned char*> mapped;  // zero-copy source or NULL
+      unsigned char* out;
+      size_t frame_size;
+      size_t parts;                           // work items per frame
+      std::atomic<size_t> next_item;
+      std::mutex error_mutex;
+      std::string error;
+
+      void fail(const std::string& msg){
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if(error.empty()){
+          error = msg;
+        }
+        // stop handing out work
+        next_item = offsets.size() * parts;
+      }
+  };
+
+  // Decode strips [PART/PARTS, (PART+1)/PARTS) of frame N, whose
+  // directory is at OFFSET, into DST of FRAME_SIZE bytes. With PARTS =
+  // 1 this is the whole frame.
+  void read_strips(TIFF* image, uint64_t offset, size_t n,
+                   unsigned char* dst, size_t frame_size,
+                   size_t part, size_t parts)
+  {
+    if(TIFFCurrentDirOffset(image) != offset &&
+       TIFFSetSubDirectory(image, offset) == 0)
+    {
+      std::ostringstream os;
+      os << "Failed switching to frame " << n << ".";
+      throw EXCEPTION(os.str());
+    }
+
+    // All strips but the last have the same decoded size.
+    const size_t strip_size = TIFFStripSize(image);
+    const size_t n_strips = TIFFNumberOfStrips(image);
+    const size_t s_begin = part * n_strips / parts;
+    const size_t s_end = (part + 1) * n_strips / parts;
+    for(size_t s=s_begin; s<s_end; ++s){
+      const size_t pos = s * strip_size;
+      if(pos >= frame_size){
+        break;
+      }
+      if(TIFFReadEncodedStrip(image, s, dst + pos, frame_size - pos) == -1){
+        std::ostringstream os;
+        os << "Error reading strip " << s << " of frame " << n << ".";
+        throw EXCEPTION(os.str());
+      }
+    }
+  }
+
+  void load_part(TIFF* image, load_job& job, size_t n, size_t part){
+    unsigned char* dst = job.out + n * job.frame_size;
+
+    if(job.mapped[n]){
+      const size_t begin = part * job.frame_size / job.parts;
+      const size_t end = (part + 1) * job.frame_size / job.parts;
+      memcpy(dst + begin, job.mapped[n] + begin, end - begin);
+      return;
+    }
+    read_strips(image, job.offsets[n], n, dst, job.frame_size, part, job.parts);
+  }
+
+  void load_thread(load_job* job){
+    TIFF* image = TIFFOpen(job->filename.c_str(), "r");
+    if(!image){
+      job->fail("Could not open image.");
+      return;
+    }
+    const size_t n_items = job->offsets.size() * job->parts;
+    try{
+      size_t k;
+      while((k = job->next_item++) < n_items){
+        load_part(image, *job, k / job->parts, k % job->parts);
+      }
+    }
+    catch(Exception& e){
+      job->fail(e.msg);
+    }
+    // Nothing may escape a std::thread.
+    catch(std::exception& e){
+      job->fail(e.what());
+    }
+    catch(...){
+      job->fail("Unknown exception.");
+    }
+    TIFFClose(image);
+  }
+}
+
+bool TiffStack::load_frames(void* out, size_t first, size_t count,
+                            size_t n_threads) const
+{
+  if(count == 0){
+    return true;
+  }
+  if(first + count > frames.size()){
+    std::cerr << "TiffStack::load_frames : frames [" << first << ", "
+              << first + count << ") out of bounds (" << frames.size()
+              << " frames)" << std::endl;
+    return false;
+  }
+
+  load_job job;
+  job.filename = filename;
+  job.out = static_cast<unsigned char*>(out);
+  job.frame_size = get_size(first);
+  for(size_t n=first; n<first+count; ++n){
+    if(get_size(n) != job.frame_size){
+      std::cerr << "TiffStack::load_frames : frame " << n
+                << " differs in size from frame " << first << std::endl;
+      return false;
+    }
+    job.offsets.push_back(frames[n].offset);
+    job.mapped.push_back(frames[n].mapped);
+  }
+
+  if(n_threads == 0){
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  n_threads = std::min(n_threads, count * job.frame_size);
+  job.parts = count >= n_threads ? 1 : n_threads;
+  job.next_item = 0;
+
+  std::vector<std::thread> threads;
+  for(size_t i=1; i<n_threads; ++i){
+    threads.push_back(std::thread(load_thread, &job));
+  }
+  load_thread(&job);
+  for(size_t i=0; i<threads.size(); ++i){
+    threads[i].join();
+  }
+
+  if(!job.error.empty()){
+    std::cerr << "TiffStack::load_frames(" << filename << ") : "
+              << job.error << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool TiffStack::load_frames(std::vector<unsigned char>& out,
+                            size_t n_threads) const
+{
+  if(frames.empty()){
+    out.clear();
+    return true;
+  }
+  out.resize(frames.size() * get_size(0));
+  return load_frames(&out[0], 0, frames.size(), n_threads);
+}
+
+// --------------------------------------------------------------------- decoder
+
+TiffStack::decoder::decoder(const TiffStack& stack_)
+  : stack(stack_),
+    image(NULL)
+{}
+
+TiffStack::decoder::~decoder(){
+  if(image){
+    TIFFClose(image);
+    image = NULL;
+  }
+}
+
+void TiffStack::decoder::load_frame(size_t n, void* out){
+  if(n >= stack.frames.size()){
+    std::ostringstream os;
+    os << "Frame " << n << " out of bounds (" << stack.frames.size()
+       << " frames).";
+    throw EXCEPTION(os.str());
+  }
+  const frame_info& fi = stack.frames[n];
+  const size_t size = stack.get_size(n);
+  if(fi.mapped){
+    memcpy(out, fi.mapped, size);
+    return;
+  }
+  if(!image && (image = TIFFOpen(stack.filename.c_str(), "r")) == NULL){
+    std::ostringstream os;
+    os << "Could not open \"" << stack.filename << "\".";
+    throw EXCEPTION(os.str());
+  }
+  read_strips(image, fi.offset, n, static_cast<unsigned char*>(out), size, 0, 1);
+}
+
+// TiffStack.cc ends here
@@ -0,0 +1,156 @@
+/* -*- mode: C++ -*- */
+/* Time-stamp: "2026-10-19 11:52:40 sb" */
+
+/*
+  file       TiffStack.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Random access to the frames of a multi-page 8 bit or 16 bit
+  grayscale TIFF stack, as written by scientific cameras.
+
+  In contrast to Tiff::load_file, the file is opened once and all
+  TIFF directory offsets are indexed when opening, so that switching
+  to frame N costs a single seek instead of walking N directories.
+
+  On POSIX systems the file is memory mapped. Frames that are stored
+  uncompressed in contiguous strips and in native byte order are
+  exposed as zero-copy pointers into the mapping. All other frames
+  are decoded lazily on first access and kept until release_frame()
+  is called.
+
+  get_frame() is not thread-safe, since all frames share one libtiff
+  handle. load_frames() decodes many frames in parallel into a single
+  buffer, with one libtiff handle per thread. A TiffStack::decoder
+  keeps its own libtiff handle for decoding single frames on one
+  thread over a longer run.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef TIFFSTACK_HH__117AED80_7F26_4754_8EA3_72A50519D022
+#define TIFFSTACK_HH__117AED80_7F26_4754_8EA3_72A50519D022
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sbutil/ImageView.hh>
+
+// libtiff handle, see tiffio.h
+struct tiff;
+
+class TiffStack {
+  private:
+    // make non-copyable
+    TiffStack(const TiffStack&);
+    TiffStack& operator=(const TiffStack&);
+
+  public:
+    TiffStack();
+    ~TiffStack();
+
+    // Open F and index all frames. Return false and print a message to
+    // std::cerr on error.
+    bool open_file(const std::string& f);
+    void close_file();
+
+    const std::string& get_filename() const {return filename;}
+    size_t get_number_of_frames() const {return frames.size();}
+
+    size_t get_width(size_t n) const {return frames[n].width;}
+    size_t get_height(size_t n) const {return frames[n].height;}
+    size_t get_bits_per_sample(size_t n) const {return frames[n].bits_per_sample;}
+    size_t get_size(size_t n) const; // Size of frame N in bytes.
+
+    // Offset of the TIFF directory of frame N in the file, for use with
+    // TIFFSetSubDirectory(3).
+    uint64_t get_directory_offset(size_t n) const {return frames[n].offset;}
+
+    // True if frame N is a zero-copy view into the memory mapped file.
+    bool is_mapped(size_t n) const {return frames[n].mapped != NULL;}
+
+    // Pixel data of frame N in row-major order and host byte order,
+    // with get_bits_per_sample(n)/8 bytes per pixel. Decodes the frame
+    // if necessary. Return NULL and print a message to std::cerr on
+    // error. The pointer stays valid until release_frame(n) or
+    // close_file().
+    const void* get_frame(size_t n);
+
+    // Typed view of frame N, see get_frame(). T must be uint8_t for 8
+    // bit and uint16_t for 16 bit frames, otherwise the view is empty.
+    template <typename T>
+    ImageView<T> get_view(size_t n){
+      if(n >= frames.size() || sizeof(T)*8 != frames[n].bits_per_sample){
+        return ImageView<T>();
+      }
+      return ImageView<T>(static_cast<const T*>(get_frame(n)),
+                          frames[n].width, frames[n].height);
+    }
+
+    // Free the decoded copy of frame N, if any.
+    void release_frame(size_t n);
+
+    // Decode COUNT frames starting at FIRST into the contiguous buffer
+    // OUT, frame after frame, using N_THREADS threads (0 means one per
+    // core). Each thread opens its own libtiff handle. Whole frames are
+    // distributed over the threads, or the strips of each frame if
+    // there are fewer frames than threads. All frames must have the
+    // same size, and OUT must hold COUNT * get_size(FIRST) bytes. Does
+    // not touch the frame cache and may run concurrently with other
+    // const member functions. Return false and print a message to
+    // std::cerr on error.
+    bool load_frames(void* out, size_t first, size_t count,
+                     size_t n_threads = 0) const;
+
+    // Decode all frames into OUT, resized as needed.
+    bool load_frames(std::vector<unsigned char>& out,
+                     size_t n_threads = 0) const;
+
+    // Frame decoding with a libtiff handle of its own, opened on first
+    // use and kept until destruction. Use one decoder per thread. The
+    // stack must stay open while the decoder is alive.
+    class decoder {
+      private:
+        const TiffStack& stack;
+        struct tiff* image;
+
+        // make non-copyable
+        decoder(const decoder&);
+        decoder& operator=(const decoder&);
+
+      public:
+        explicit decoder(const TiffStack& stack_);
+        ~decoder();
+
+        // Decode frame N into OUT, which must hold get_size(N) bytes.
+        // Throws Exception on error.
+        void load_frame(size_t n, void* out);
+    };
+
+  private:
+    struct frame_info {
+        uint64_t offset;
+        size_t width;
+        size_t height;
+        size_t bits_per_sample;
+        const unsigned char* mapped;
+        std::vector<unsigned char> decoded;
+    };
+
+    bool map_file();
+    void unmap_file();
+    void index_frame();
+    void decode_frame(size_t n);
+
+    std::string filename;
+    struct tiff* image;
+    int fd;
+    const unsigned char* map;
+    size_t map_size;
+    std::vector<frame_info> frames;
+};
+
+#endif /* TIFFSTACK_HH__117AED80_7F26_4754_8EA3_72A50519D022 */
+
+/* TiffStack.hh ends here */
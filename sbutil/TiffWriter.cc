@@ -0,0 +1,235 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 12:10:47 sb"
+
+/*
+  file       TiffWriter.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/TiffWriter.hh>
+#include <sbutil/Exception.hh>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <tiffio.h>
+#include <zlib.h>
+
+// Target size of a strip if rows_per_strip is not set.
+static const size_t DEFAULT_STRIP_BYTES = 65536;
+
+// Classic TIFF uses 32 bit file offsets. Keep some room for the
+// directories.
+static const uint64_t CLASSIC_TIFF_MAX_BYTES = 0xffffffffull - (1u << 20);
+
+TiffWriter::TiffWriter()
+  : filename(),
+    image(NULL),
+    bigtiff(false),
+    deflate_level(0),
+    n_threads(0),
+    rows_per_strip(0),
+    frames(0),
+    bytes_written(0)
+{}
+
+TiffWriter::~TiffWriter(){
+  close_file();
+}
+
+bool TiffWriter::open_file(const std::string& f, bool bigtiff_){
+  close_file();
+  if((image = TIFFOpen(f.c_str(), bigtiff_ ? "w8" : "w")) == NULL){
+    std::cerr << "TiffWriter::open_file(" << f << ") : "
+              << "Could not create image." << std::endl;
+    return false;
+  }
+  filename = f;
+  bigtiff = bigtiff_;
+  frames = 0;
+  bytes_written = 0;
+  return true;
+}
+
+void TiffWriter::close_file(){
+  if(image){
+    TIFFClose(image);
+    image = NULL;
+  }
+  filename.clear();
+}
+
+bool TiffWriter::write_frame(const ImageView<uint8_t>& v){
+  return write_frame(reinterpret_cast<const unsigned char*>(v.get_data()),
+                     v.get_width(), v.get_height(), v.get_stride(),
+                     8, SAMPLEFORMAT_UINT);
+}
+
+bool TiffWriter::write_frame(const ImageView<uint16_t>& v){
+  return write_frame(reinterpret_cast<const unsigned char*>(v.get_data()),
+                     v.get_width(), v.get_height(), v.get_stride() * 2,
+                     16, SAMPLEFORMAT_UINT);
+}
+
+bool TiffWriter::write_frame(const ImageView<float>& v){
+  return write_frame(reinterpret_cast<const unsigned char*>(v.get_data()),
+                     v.get_width(), v.get_height(), v.get_stride() * 4,
+                     32, SAMPLEFORMAT_IEEEFP);
+}
+
+namespace
+{
+  void check_size(bool bigtiff, uint64_t bytes){
+    if(!bigtiff && bytes > CLASSIC_TIFF_MAX_BYTES){
+      throw EXCEPTION("File would exceed 4 GB, open it as BigTIFF.");
+    }
+  }
+
+  // Copy ROWS rows of ROW_SIZE bytes, STRIDE bytes apart, to OUT.
+  void gather_rows(const unsigned char* data, size_t row_size, size_t stride,
+                   size_t rows, std::vector<unsigned char>& out)
+  {
+    out.resize(rows * row_size);
+    for(size_t r=0; r<rows; ++r){
+      memcpy(&out[r * row_size], data + r * stride, row_size);
+    }
+  }
+}
+
+bool TiffWriter::write_frame(const unsigned char* data,
+                             size_t width, size_t height, size_t stride,
+                             size_t bits_per_sample, int sample_format)
+{
+  try{
+    if(!image){
+      throw EXCEPTION("No file open.");
+    }
+    if(data == NULL || width == 0 || height == 0){
+      throw EXCEPTION("Empty frame.");
+    }
+
+    const size_t row_size = width * (bits_per_sample / 8);
+    size_t rows = rows_per_strip;
+    if(rows == 0){
+      rows = std::max<size_t>(1, DEFAULT_STRIP_BYTES / row_size);
+    }
+    rows = std::min(rows, height);
+
+    TIFFSetField(image, TIFFTAG_SUBFILETYPE, FILETYPE_PAGE);
+    TIFFSetField(image, TIFFTAG_IMAGEWIDTH, static_cast<uint32_t>(width));
+    TIFFSetField(image, TIFFTAG_IMAGELENGTH, static_cast<uint32_t>(height));
+    TIFFSetField(image, TIFFTAG_BITSPERSAMPLE, static_cast<int>(bits_per_sample));
+    TIFFSetField(image, TIFFTAG_SAMPLESPERPIXEL, 1);
+    TIFFSetField(image, TIFFTAG_SAMPLEFORMAT, sample_format);
+    TIFFSetField(image, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
+    TIFFSetField(image, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
+    TIFFSetField(image, TIFFTAG_ROWSPERSTRIP, static_cast<uint32_t>(rows));
+    TIFFSetField(image, TIFFTAG_COMPRESSION,
+                 deflate_level > 0 ? COMPRESSION_ADOBE_DEFLATE : COMPRESSION_NONE);
+
+    if(deflate_level > 0){
+      write_strips_compressed(data, row_size, height, stride, rows);
+    }
+    else{
+      check_size(bigtiff, bytes_written + height * row_size);
+      std::vector<unsigned char> tmp;
+      const size_t n_strips = (height + rows - 1) / rows;
+      for(size_t s=0; s<n_strips; ++s){
+        const size_t r = std::min(rows, height - s * rows);
+        const unsigned char* p = data + s * rows * stride;
+        if(stride != row_size){
+          gather_rows(p, row_size, stride, r, tmp);
+          p = &tmp[0];
+        }
+        if(TIFFWriteEncodedStrip(image, s, const_cast<unsigned char*>(p),
+                                 r * row_size) == -1)
+        {
+          std::ostringstream os;
+          os << "Error writing strip " << s << ".";
+          throw EXCEPTION(os.str());
+        }
+      }
+      bytes_written += height * row_size;
+    }
+
+    if(TIFFWriteDirectory(image) == 0){
+      throw EXCEPTION("Error writing directory.");
+    }
+  }
+  catch(Exception& e){
+    std::cerr << "TiffWriter::write_frame(" << filename << ", frame "
+              << frames << ") : " << e << std::endl;
+    return false;
+  }
+  ++frames;
+  return true;
+}
+
+void TiffWriter::write_strips_compressed(const unsigned char* data,
+                                         size_t row_size, size_t height,
+                                         size_t stride, size_t rows)
+{
+  const size_t n_strips = (height + rows - 1) / rows;
+  std::vector<std::vector<unsigned char> > strips(n_strips);
+  std::atomic<size_t> next_strip(0);
+  std::atomic<bool> failed(false);
+  const int level = std::min(deflate_level, 9);
+
+  auto compress_strips = [&](){
+    std::vector<unsigned char> tmp;
+    size_t s;
+    while(!failed && (s = next_strip++) < n_strips){
+      const size_t r = std::min(rows, height - s * rows);
+      const unsigned char* p = data + s * rows * stride;
+      if(stride != row_size){
+        gather_rows(p, row_size, stride, r, tmp);
+        p = &tmp[0];
+      }
+      uLongf size = compressBound(r * row_size);
+      strips[s].resize(size);
+      if(compress2(&strips[s][0], &size, p, r * row_size, level) != Z_OK){
+        failed = true;
+      }
+      strips[s].resize(size);
+    }
+  };
+
+  size_t n = n_threads;
+  if(n == 0){
+    n = std::max(1u, std::thread::hardware_concurrency());
+  }
+  n = std::min(n, n_strips);
+  std::vector<std::thread> threads;
+  for(size_t i=1; i<n; ++i){
+    threads.push_back(std::thread(compress_strips));
+  }
+  compress_strips();
+  for(size_t i=0; i<threads.size(); ++i){
+    threads[i].join();
+  }
+  if(failed){
+    throw EXCEPTION("Error compressing strip.");
+  }
+
+  uint64_t total = 0;
+  for(size_t s=0; s<n_strips; ++s){
+    total += strips[s].size();
+  }
+  check_size(bigtiff, bytes_written + total);
+
+  for(size_t s=0; s<n_strips; ++s){
+    if(TIFFWriteRawStrip(image, s, &strips[s][0], strips[s].size()) == -1){
+      std::ostringstream os;
+      os << "Error writing strip " << s << ".";
+      throw EXCEPTION(os.str());
+    }
+  }
+  bytes_written += total;
+}
+
+// TiffWriter.cc ends here
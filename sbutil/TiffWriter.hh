@@ -0,0 +1,92 @@
+/* -*- mode: C++ -*- */
+/* Time-stamp: "2026-10-19 12:10:47 sb" */
+
+/*
+  file       TiffWriter.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Stream grayscale frames into a multi-page TIFF file, one TIFF
+  directory per frame. Only the frame currently being written is held
+  in memory.
+
+  Samples can be 8 or 16 bit unsigned integers or 32 bit floats. The
+  classic TIFF format cannot address more than 4 GB. Pass bigtiff =
+  true to open_file() for larger stacks.
+
+  With deflate compression enabled, the strips of each frame are
+  compressed in parallel with zlib and then handed to libtiff as raw
+  strips, so that only the file I/O is serialized.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef TIFFWRITER_HH__335D7FEC_6439_481C_8D6F_D0A23F8358D2
+#define TIFFWRITER_HH__335D7FEC_6439_481C_8D6F_D0A23F8358D2
+
+#include <string>
+#include <stdint.h>
+#include <sbutil/ImageView.hh>
+
+// libtiff handle, see tiffio.h
+struct tiff;
+
+class TiffWriter {
+  private:
+    // make non-copyable
+    TiffWriter(const TiffWriter&);
+    TiffWriter& operator=(const TiffWriter&);
+
+  public:
+    TiffWriter();
+    ~TiffWriter();
+
+    // Create F, truncating an existing file. Write BigTIFF if BIGTIFF
+    // is set. Return false and print a message to std::cerr on error.
+    bool open_file(const std::string& f, bool bigtiff = false);
+
+    // Finish the file. Every frame's directory is already written by
+    // write_frame(), so this only flushes and closes.
+    void close_file();
+
+    bool is_open() const {return image != NULL;}
+    const std::string& get_filename() const {return filename;}
+    size_t get_number_of_frames() const {return frames;}
+
+    // Deflate-compress subsequent frames at zlib LEVEL 1..9, or store
+    // them uncompressed if LEVEL is 0. Default: uncompressed.
+    void set_compression(int level) {deflate_level = level;}
+
+    // Number of threads compressing strips, 0 means one per core.
+    void set_threads(size_t n) {n_threads = n;}
+
+    // Rows per strip, 0 means strips of about 64 kB.
+    void set_rows_per_strip(size_t n) {rows_per_strip = n;}
+
+    // Append V as the next frame. Return false and print a message to
+    // std::cerr on error.
+    bool write_frame(const ImageView<uint8_t>& v);
+    bool write_frame(const ImageView<uint16_t>& v);
+    bool write_frame(const ImageView<float>& v);
+
+  private:
+    bool write_frame(const unsigned char* data,
+                     size_t width, size_t height, size_t stride,
+                     size_t bits_per_sample, int sample_format);
+    void write_strips_compressed(const unsigned char* data, size_t row_size,
+                                 size_t height, size_t stride, size_t rows);
+
+    std::string filename;
+    struct tiff* image;
+    bool bigtiff;
+    int deflate_level;
+    size_t n_threads;
+    size_t rows_per_strip;
+    size_t frames;
+    uint64_t bytes_written;
+};
+
+#endif /* TIFFWRITER_HH__335D7FEC_6439_481C_8D6F_D0A23F8358D2 */
+
+/* TiffWriter.hh ends here */
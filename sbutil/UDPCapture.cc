@@ -0,0 +1,344 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 16:20:12 sb"
+
+/*
+  file       UDPCapture.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/UDPCapture.hh>
+#include <sbutil/Serializer.hh>
+#include <sbutil/Timestamp.hh>
+#include <sbutil/HDF5File.hh>
+#include <sbutil/Exception.hh>
+
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+namespace HDF5
+{
+  template<> struct CompoundTraits<UDPCaptureRecord> {
+      static void Describe(CompoundType& t){
+        t.Insert<uint32_t>("seconds", HOFFSET(UDPCaptureRecord, seconds));
+        t.Insert<uint32_t>("microseconds", HOFFSET(UDPCaptureRecord, microseconds));
+        t.Insert<uint32_t>("address", HOFFSET(UDPCaptureRecord, address));
+        t.Insert<uint16_t>("port", HOFFSET(UDPCaptureRecord, port));
+        t.Insert<uint32_t>("length", HOFFSET(UDPCaptureRecord, length));
+        t.Insert<uint64_t>("offset", HOFFSET(UDPCaptureRecord, offset));
+      }
+  };
+}
+
+static const char LOG_MAGIC[8] = {'S', 'B', 'U', 'D', 'P', 'C', 'A', 'P'};
+static const uint32_t LOG_VERSION = 1;
+
+// Bytes per record header in the log: seconds, microseconds, address,
+// port, length.
+static const size_t LOG_RECORD_SIZE = 4 + 4 + 4 + 2 + 4;
+
+// ---------------------------------------------------------------------- recorder
+
+UDPRecorder::UDPRecorder(UDPClient& client_,
+                         size_t batch_capacity,
+                         size_t buffer_size)
+  : client(client_),
+    batch(batch_capacity, buffer_size ? buffer_size : client_.GetMaxDatagramSize()),
+    log(NULL),
+    staging(),
+    records(),
+    record_dataset(),
+    payload_dataset(),
+    packets(0),
+    bytes(0)
+{
+  staging.reserve(batch_capacity * (LOG_RECORD_SIZE + batch.GetBufferSize()));
+  records.reserve(batch_capacity);
+}
+
+UDPRecorder::~UDPRecorder(){
+  try{
+    Close();
+  }
+  catch(Exception&){
+  }
+}
+
+void UDPRecorder::OpenLog(const std::string& filename){
+  if(log){
+    throw EXCEPTION("Log already open.");
+  }
+  if((log = fopen(filename.c_str(), "wb")) == NULL){
+    std::ostringstream os;
+    os << "Failed to open \"" << filename << "\" for writing\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  uint8_t header[sizeof(LOG_MAGIC) + 4];
+  ByteWriter w(header, sizeof(header));
+  w.PutBytes(LOG_MAGIC, sizeof(LOG_MAGIC));
+  w.Put(LOG_VERSION);
+  if(fwrite(header, 1, w.GetSize(), log) != w.GetSize()){
+    fclose(log);
+    log = NULL;
+    std::ostringstream os;
+    os << "Failed to write header of \"" << filename << "\".";
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPRecorder::OpenDatasets(HDF5::File& file,
+                               const std::string& path,
+                               const std::string& name)
+{
+  if(record_dataset){
+    throw EXCEPTION("Datasets already open.");
+  }
+  record_dataset.reset(new HDF5::AppendableDataset(file, path, name + "_records",
+                                                   std::vector<size_t>(),
+                                                   HDF5::NativeType<UDPCaptureRecord>::Get()));
+  payload_dataset.reset(new HDF5::AppendableDataset(file, path, name + "_payload",
+                                                    std::vector<size_t>(),
+                                                    H5T_STD_U8LE));
+}
+
+void UDPRecorder::Close(){
+  // Close the datasets first, so that a failing fclose() does not
+  // leave the HDF5 capture unflushed.
+  if(record_dataset){
+    try{
+      record_dataset->Flush();
+      payload_dataset->Flush();
+    }
+    catch(Exception&){
+      record_dataset.reset();
+      payload_dataset.reset();
+      if(log){
+        fclose(log);
+        log = NULL;
+      }
+      throw;
+    }
+    record_dataset.reset();
+    payload_dataset.reset();
+  }
+  if(log){
+    const int rc = fclose(log);
+    log = NULL;
+    if(rc != 0){
+      std::ostringstream os;
+      os << "fclose() failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+}
+
+void UDPRecorder::WriteLog(){
+  staging.clear();
+  for(size_t i=0; i<records.size(); ++i){
+    const UDPCaptureRecord& r = records[i];
+    const size_t start = staging.size();
+    staging.resize(start + LOG_RECORD_SIZE + r.length);
+    ByteWriter w(&staging[start], LOG_RECORD_SIZE + r.length);
+    w.Put(r.seconds);
+    w.Put(r.microseconds);
+    w.Put(r.address);
+    w.Put(r.port);
+    w.Put(r.length);
+    w.PutBytes(batch.GetData(i), r.length);
+  }
+  if(fwrite(&staging[0], 1, staging.size(), log) != staging.size()){
+    std::ostringstream os;
+    os << "Failed writing to log\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPRecorder::WriteDatasets(){
+  staging.clear();
+  const uint64_t start = payload_dataset->GetRows();
+  for(size_t i=0; i<records.size(); ++i){
+    records[i].offset = start + staging.size();
+    staging.insert(staging.end(), batch.GetData(i), batch.GetData(i) + records[i].length);
+  }
+  record_dataset->AppendRecords(&records[0], records.size());
+  if(!staging.empty()){
+    payload_dataset->Append(H5T_NATIVE_UINT8, &staging[0], staging.size());
+  }
+}
+
+UDPClient::receive_state_t UDPRecorder::RecordBatch(bool nothrow){
+  const UDPClient::receive_state_t rc = client.ReceiveBatch(batch, nothrow);
+  if(rc != UDPClient::OK){
+    return rc;
+  }
+  const Timestamp now;
+
+  records.resize(batch.GetSize());
+  for(size_t i=0; i<batch.GetSize(); ++i){
+    UDPCaptureRecord& r = records[i];
+    const int64_t t = batch.GetKernelTimestamp(i);
+    if(t != 0){
+      r.seconds = static_cast<uint32_t>(t / 1000000000);
+      r.microseconds = static_cast<uint32_t>((t % 1000000000) / 1000);
+    }
+    else{
+      r.seconds = now.GetSeconds();
+      r.microseconds = now.GetMicroSeconds();
+    }
+    r.address = batch.GetAddressHostOrder(i);
+    r.port = batch.GetPort(i);
+    r.length = batch.GetLength(i);
+    r.offset = 0;
+    bytes += r.length;
+  }
+  packets += records.size();
+
+  if(log){
+    WriteLog();
+  }
+  if(record_dataset){
+    WriteDatasets();
+  }
+  return rc;
+}
+
+size_t UDPRecorder::Record(size_t max_packets){
+  const size_t start = packets;
+  while(max_packets == 0 || packets - start < max_packets){
+    if(RecordBatch(true) != UDPClient::OK){
+      break;
+    }
+  }
+  return packets - start;
+}
+
+// ---------------------------------------------------------------------- replayer
+
+UDPReplayer::UDPReplayer()
+  : records(),
+    times(),
+    payload()
+{}
+
+void UDPReplayer::Index(){
+  times.resize(records.size());
+  for(size_t i=0; i<records.size(); ++i){
+    times[i] = (static_cast<double>(records[i].seconds) - records[0].seconds)
+      + (static_cast<double>(records[i].microseconds) - records[0].microseconds) * 1e-6;
+  }
+}
+
+void UDPReplayer::LoadLog(const std::string& filename){
+  records.clear();
+  payload.clear();
+
+  FILE* in = fopen(filename.c_str(), "rb");
+  if(in == NULL){
+    std::ostringstream os;
+    os << "Failed to open \"" << filename << "\" for reading\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  // The whole file becomes the payload buffer, records point into it.
+  uint8_t chunk[1 << 16];
+  size_t n;
+  while((n = fread(chunk, 1, sizeof(chunk), in)) > 0){
+    payload.insert(payload.end(), chunk, chunk + n);
+  }
+  fclose(in);
+
+  ByteReader r(payload.data(), payload.size());
+  const uint8_t* magic = r.GetBytes(sizeof(LOG_MAGIC));
+  const uint32_t version = r.Get<uint32_t>();
+  if(!r.Ok() || memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0 || version != LOG_VERSION){
+    std::ostringstream os;
+    os << "\"" << filename << "\" is not a UDP capture log of version "
+       << LOG_VERSION << ".";
+    throw EXCEPTION(os.str());
+  }
+
+  // An incomplete last record, e.g. from a recorder that was killed,
+  // is ignored.
+  while(r.GetRemaining() >= LOG_RECORD_SIZE){
+    UDPCaptureRecord c;
+    r.Get(c.seconds);
+    r.Get(c.microseconds);
+    r.Get(c.address);
+    r.Get(c.port);
+    r.Get(c.length);
+    c.offset = r.GetPosition();
+    if(r.GetBytes(c.length) == NULL){
+      break;
+    }
+    records.push_back(c);
+  }
+  Index();
+}
+
+void UDPReplayer::LoadDatasets(HDF5::File& file,
+                               const std::string& path,
+                               const std::string& name)
+{
+  file.ReadDatasetCompound(path, name + "_records", records);
+  file.ReadDatasetCompound(path, name + "_payload", payload);
+  for(size_t i=0; i<records.size(); ++i){
+    if(records[i].offset + records[i].length > payload.size()){
+      std::ostringstream os;
+      os << "Record " << i << " of " << path << "/" << name
+         << " points past the end of the payload.";
+      throw EXCEPTION(os.str());
+    }
+  }
+  Index();
+}
+
+size_t UDPReplayer::Replay(const UDPServer& server,
+                           const UDPDestination& destination,
+                           double speed,
+                           bool nothrow) const
+{
+  typedef std::chrono::steady_clock clock;
+  const clock::time_point start = clock::now();
+
+  UDPMessage messages[UDP_SEND_BATCH];
+  size_t sent = 0;
+  size_t i = 0;
+  while(i < records.size()){
+    clock::time_point now;
+    if(speed > 0){
+      const clock::time_point due =
+        start + std::chrono::duration_cast<clock::duration>(
+          std::chrono::duration<double>(times[i] / speed));
+      std::this_thread::sleep_until(due);
+      now = clock::now();
+    }
+
+    // Collect everything that is due by now.
+    size_t k = 0;
+    for(; k<UDP_SEND_BATCH && i + k<records.size(); ++k){
+      if(speed > 0 &&
+         start + std::chrono::duration_cast<clock::duration>(
+           std::chrono::duration<double>(times[i + k] / speed)) > now)
+      {
+        break;
+      }
+      messages[k] = UDPMessage(destination, GetData(i + k), records[i + k].length);
+    }
+
+    const size_t m = server.SendBatch(messages, k, nothrow);
+    sent += m;
+    if(m < k){
+      break;
+    }
+    i += k;
+  }
+  return sent;
+}
+
+// UDPCapture.cc ends here
@@ -0,0 +1,163 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 18:05:51 sb"
+
+/*
+  file       UDPCapture.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Record a UDP stream with arrival times and play it back later, e.g.
+  to load-test a consumer on loopback without the hardware that
+  normally sends the data.
+
+  UDPRecorder receives batches on a UDPClient and stores every
+  datagram with its arrival Timestamp, source address and port. The
+  capture goes to a compact binary log, to two appendable datasets in
+  an HDF5 file, or to both:
+
+    log file   "SBUDPCAP", uint32 version, then per datagram the
+               fields of UDPCaptureRecord except OFFSET, followed by
+               LENGTH payload bytes. Network byte order, see
+               Serializer.hh.
+
+    HDF5       NAME_records: UDPCaptureRecord compound rows
+               NAME_payload: all payloads concatenated as uint8, the
+                             payload of a record starts at OFFSET
+
+  Arrival times are the kernel receive timestamps if
+  UDPClient::EnableKernelTimestamps is on, which keeps the spacing of
+  datagrams fetched by the same recvmmsg(2) call. Otherwise they are
+  taken once per received batch, and such datagrams share a
+  timestamp.
+
+  UDPReplayer loads a capture into memory and sends it to a
+  UDPDestination with a UDPServer, with the original spacing, scaled
+  by a speed factor, or as fast as possible.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef UDPCAPTURE_HH__04ADAC8A_C507_455F_AC2F_7F21C12AA3D6
+#define UDPCAPTURE_HH__04ADAC8A_C507_455F_AC2F_7F21C12AA3D6
+
+#include <sbutil/UDPClient.hh>
+#include <sbutil/UDPServer.hh>
+
+#include <cstdio>
+#include <memory>
+#include <stdint.h>
+
+namespace HDF5
+{
+  class File;
+  class AppendableDataset;
+}
+
+// Header of one captured datagram.
+struct UDPCaptureRecord {
+    uint32_t seconds;      // arrival time, see Timestamp
+    uint32_t microseconds;
+    uint32_t address;      // IPV4 source, host byte order, 0 for IPV6
+    uint16_t port;
+    uint32_t length;       // payload bytes
+    uint64_t offset;       // start of the payload in NAME_payload, not in the log
+};
+
+class UDPRecorder {
+  private:
+    UDPClient& client;
+    UDPReceiveBatch batch;
+    std::FILE* log;
+    std::vector<uint8_t> staging;
+    std::vector<UDPCaptureRecord> records;
+    std::unique_ptr<HDF5::AppendableDataset> record_dataset;
+    std::unique_ptr<HDF5::AppendableDataset> payload_dataset;
+    size_t packets;
+    uint64_t bytes;
+
+    // make non-copyable
+    UDPRecorder(const UDPRecorder&);
+    UDPRecorder& operator=(const UDPRecorder&);
+
+    void WriteLog();
+    void WriteDatasets();
+
+  public:
+    // Receive from CLIENT, which must be open and stay open while
+    // recording, up to BATCH_CAPACITY datagrams of at most BUFFER_SIZE
+    // bytes per system call, 0 meaning CLIENT.GetMaxDatagramSize().
+    // Longer datagrams are recorded truncated.
+    UDPRecorder(UDPClient& client_,
+                size_t batch_capacity = 32,
+                size_t buffer_size = 0);
+    ~UDPRecorder();
+
+    // Start writing the binary log FILENAME, replacing an existing file.
+    void OpenLog(const std::string& filename);
+
+    // Start appending to the datasets NAME_records and NAME_payload in
+    // the group PATH of FILE, creating them if needed. FILE must stay
+    // open until Close().
+    void OpenDatasets(HDF5::File& file,
+                      const std::string& path,
+                      const std::string& name);
+
+    // Flush and close the log and the datasets.
+    void Close();
+
+    // Receive one batch and record it. Returns the state of
+    // UDPClient::ReceiveBatch.
+    UDPClient::receive_state_t RecordBatch(bool nothrow = false);
+
+    // Record until a receive returns anything but OK, or until at
+    // least MAX_PACKETS (0: no limit) datagrams have been recorded.
+    // Set a timeout on the client to stop when the stream goes idle,
+    // or call UDPClient::Shutdown() from another thread. Returns the
+    // number of datagrams recorded by this call.
+    size_t Record(size_t max_packets = 0);
+
+    size_t GetPackets() const {return packets;}
+    uint64_t GetBytes() const {return bytes;}
+};
+
+class UDPReplayer {
+  private:
+    std::vector<UDPCaptureRecord> records;
+    std::vector<double> times; // seconds since the first record
+    std::vector<uint8_t> payload;
+
+    void Index();
+
+  public:
+    UDPReplayer();
+
+    // Load a capture written by UDPRecorder, replacing the current
+    // one.
+    void LoadLog(const std::string& filename);
+    void LoadDatasets(HDF5::File& file,
+                      const std::string& path,
+                      const std::string& name);
+
+    size_t GetSize() const {return records.size();}
+    const UDPCaptureRecord& GetRecord(size_t i) const {return records[i];}
+    const uint8_t* GetData(size_t i) const {return payload.data() + records[i].offset;}
+
+    // Time between first and last datagram in seconds.
+    double GetDuration() const {return times.empty() ? 0.0 : times.back();}
+
+    // Send all datagrams to DESTINATION. With SPEED > 0, datagram I
+    // leaves (t_I - t_0) / SPEED after the first one, where t_I is its
+    // arrival time, so 1 keeps the original pace and 10 plays back
+    // ten times faster. Datagrams that are due are sent together with
+    // UDPServer::SendBatch. With SPEED = 0, send everything as fast as
+    // possible. Returns the number of datagrams sent.
+    size_t Replay(const UDPServer& server,
+                  const UDPDestination& destination,
+                  double speed = 1.0,
+                  bool nothrow = false) const;
+};
+
+#endif // UDPCAPTURE_HH__04ADAC8A_C507_455F_AC2F_7F21C12AA3D6
+
+// UDPCapture.hh ends here
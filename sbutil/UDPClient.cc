@@ -1,9 +1,9 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-12 16:28:21 sb"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       UDPClient.cc
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
 */
 
@@ -13,21 +13,174 @@
 #include <sstream>
 #include <cstdio>
 #include <cstring>
+#include <ctime>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #if (SB_UTIL_PLATFORM == SB_UTIL_PLATFORM_OSX)
 #include <unistd.h>
 #endif
 
 #include <sbutil/UDPClient.hh>
+#include <sbutil/UDPStatistics.hh>
+#include <sbutil/IPUtilities.hh>
 #include <sbutil/Exception.hh>
 
-UDPClient::UDPClient(unsigned short port)
+// Room for the control messages requested by
+// UDPClient::EnableKernelTimestamps and EnableKernelDropCounter.
+static const size_t CONTROL_SIZE =
+  CMSG_SPACE(sizeof(struct timespec)) + CMSG_SPACE(sizeof(uint32_t));
+
+// Microseconds on the monotonic clock, for the spin receive timeout.
+static inline int64_t monotonic_microseconds(){
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return static_cast<int64_t>(t.tv_sec) * 1000000 + t.tv_nsec / 1000;
+}
+
+// Tell the CPU that we are in a spin loop.
+static inline void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+// True if a source written by recvmsg(2) is IPV4, possibly mapped into
+// IPV6 by a dual-stack socket.
+static inline bool source_is_ipv4(const struct sockaddr_in6& s){
+  return s.sin6_family == AF_INET || IN6_IS_ADDR_V4MAPPED(&s.sin6_addr);
+}
+
+// IPV4 address of a source in host byte order, 0 if it is a real IPV6
+// address.
+static inline uint32_t source_ipv4(const struct sockaddr_in6& s){
+  if(s.sin6_family == AF_INET){
+    struct sockaddr_in v4;
+    memcpy(&v4, &s, sizeof(v4));
+    return ntohl(v4.sin_addr.s_addr);
+  }
+  return IPAddress(s.sin6_addr.s6_addr).GetIPV4();
+}
+
+// sin_port and sin6_port are at the same offset.
+static inline unsigned short source_port(const struct sockaddr_in6& s){
+  return ntohs(s.sin6_port);
+}
+
+// Pick the kernel timestamp and drop counter out of the control
+// messages of H. Leaves the arguments alone if they are not present.
+static void parse_control(struct msghdr* h, int64_t& timestamp, uint32_t& drop_counter){
+  for(struct cmsghdr* c = CMSG_FIRSTHDR(h); c != NULL; c = CMSG_NXTHDR(h, c)){
+    if(c->cmsg_level != SOL_SOCKET){
+      continue;
+    }
+#ifdef SCM_TIMESTAMPNS
+    if(c->cmsg_type == SCM_TIMESTAMPNS){
+      struct timespec t;
+      memcpy(&t, CMSG_DATA(c), sizeof(t));
+      timestamp = static_cast<int64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+    }
+#endif
+#ifdef SO_RXQ_OVFL
+    if(c->cmsg_type == SO_RXQ_OVFL){
+      memcpy(&drop_counter, CMSG_DATA(c), sizeof(drop_counter));
+    }
+#endif
+  }
+}
+
+// ------------------------------------------------------------- UDPReceiveBatch
+
+UDPReceiveBatch::UDPReceiveBatch(size_t capacity_, size_t buffer_size_)
+  : capacity(capacity_ > 0 ? capacity_ : 1),
+    buffer_size(buffer_size_),
+    size(0),
+    storage(capacity * buffer_size),
+    lengths(capacity, 0),
+    truncated(capacity, 0),
+    sources(capacity),
+    control(capacity * CONTROL_SIZE),
+    timestamps(capacity, 0),
+    drop_counter(0),
+    iov(NULL),
+    headers(NULL)
+{
+  iov = new struct iovec[capacity];
+  for(size_t i=0; i<capacity; ++i){
+    iov[i].iov_base = &storage[i * buffer_size];
+    iov[i].iov_len = buffer_size;
+  }
+#if SBUTIL_IS_PLATFORM_LINUX
+  headers = new struct mmsghdr[capacity];
+  memset(headers, 0, capacity * sizeof(struct mmsghdr));
+  for(size_t i=0; i<capacity; ++i){
+    headers[i].msg_hdr.msg_name = &sources[i];
+    headers[i].msg_hdr.msg_iov = &iov[i];
+    headers[i].msg_hdr.msg_iovlen = 1;
+  }
+#endif
+}
+
+UDPReceiveBatch::~UDPReceiveBatch(){
+  delete[] iov;
+#if SBUTIL_IS_PLATFORM_LINUX
+  delete[] headers;
+#endif
+}
+
+uint32_t UDPReceiveBatch::GetAddressHostOrder(size_t i) const {
+  return source_ipv4(sources[i]);
+}
+
+IPAddress UDPReceiveBatch::GetIPAddress(size_t i) const {
+  if(source_is_ipv4(sources[i])){
+    return IPAddress(source_ipv4(sources[i]));
+  }
+  return IPAddress(sources[i].sin6_addr.s6_addr);
+}
+
+std::string UDPReceiveBatch::GetAddress(size_t i) const {
+  return GetIPAddress(i).ToString();
+}
+
+unsigned short UDPReceiveBatch::GetPort(size_t i) const {
+  return source_port(sources[i]);
+}
+
+bool UDPReceiveBatch::CopyTo(size_t i, UDPPacket& p, bool nothrow) const {
+  p.SetData(GetData(i), GetLength(i));
+  if(source_is_ipv4(sources[i])){
+    p.SetAddress(source_ipv4(sources[i]));
+  }
+  else{
+    p.SetAddress(GetAddress(i));
+  }
+  p.SetPort(GetPort(i));
+  return p.Deserialize(nothrow);
+}
+
+// ------------------------------------------------------------------- UDPClient
+
+UDPClient::UDPClient(unsigned short port, bool reuse_port_, family_t family_)
   : fd_socket(0),
+    family(family_),
     timeout_microsecond(0),
+    close_delay_seconds(CLOSE_SOCKET_DELAY_SECONDS),
+    shutting_down(false),
+    nonblocking(false),
+    reuse_port(reuse_port_),
+    kernel_drop_counter(false),
+    kernel_timestamps(false),
+    receive_buffer_size(0),
+    receive_buffer_force(false),
+    busy_poll_microseconds(0),
+    spin_receive(false),
+    statistics(NULL),
+    receive_buffer(family_ == IPV4_ONLY ? MAX_UDP_PACKET_LENGTH : MAX_UDP6_PACKET_LENGTH),
     client_port(port)
 {
   memset((void*)&client_socket_address, 0, sizeof(client_socket_address));
@@ -42,12 +195,20 @@ void UDPClient::OpenSocket(){
   if(fd_socket) { // socket already opened
     return;
   }
-  if((fd_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) == -1){
+  shutting_down = false;
+  const int domain = family == IPV4_ONLY ? AF_INET : AF_INET6;
+  if((fd_socket = socket(domain, SOCK_DGRAM, IPPROTO_UDP)) == -1){
+    fd_socket = 0;
     std::ostringstream os;
-    os << "socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) failed\n"
+    os << "socket(" << (domain == AF_INET ? "AF_INET" : "AF_INET6")
+       << ", SOCK_DGRAM, IPPROTO_UDP) failed\n"
        << strerror(errno);
     throw EXCEPTION(os.str());
   }
+  // The kernel's drop counter starts from zero on the new socket.
+  if(statistics){
+    statistics->ResetKernelDropCounter();
+  }
 
 #if USE_SO_REUSEADDR != 0
   // use SO_REUSEADDR to avoid hanging in this state
@@ -72,30 +233,89 @@ void UDPClient::OpenSocket(){
   }
 #endif
 
-  client_socket_address.sin_family = AF_INET;
-  client_socket_address.sin_port = htons(client_port);
-  client_socket_address.sin_addr.s_addr = htonl(INADDR_ANY);
+  if(reuse_port){
+#ifdef SO_REUSEPORT
+    int one = 1;
+    if(setsockopt(fd_socket, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) == -1){
+      std::ostringstream os;
+      os << "setsockopt(SOL_SOCKET, SO_REUSEPORT, 1, sizeof(int)) failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+#else
+    throw EXCEPTION("SO_REUSEPORT is not supported on this platform.");
+#endif
+  }
 
-  if(bind(fd_socket, (const sockaddr*)&client_socket_address,
-          sizeof(client_socket_address)) == -1)
-  {
-    std::ostringstream os;
-    os << "bind(INADDR_ANY:" << client_port << ") failed\n"
-       << strerror(errno);
-    throw EXCEPTION(os.str());
+  if(family == IPV4_ONLY){
+    client_socket_address.sin_family = AF_INET;
+    client_socket_address.sin_port = htons(client_port);
+    client_socket_address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if(bind(fd_socket, (const sockaddr*)&client_socket_address,
+            sizeof(client_socket_address)) == -1)
+    {
+      std::ostringstream os;
+      os << "bind(INADDR_ANY:" << client_port << ") failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+  else{
+    // Do not depend on the net.ipv6.bindv6only default.
+    int v6only = family == IPV6_ONLY ? 1 : 0;
+    if(setsockopt(fd_socket, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof(v6only)) == -1){
+      std::ostringstream os;
+      os << "setsockopt(IPPROTO_IPV6, IPV6_V6ONLY, " << v6only << ") failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+    struct sockaddr_in6 a;
+    memset(&a, 0, sizeof(a));
+    a.sin6_family = AF_INET6;
+    a.sin6_port = htons(client_port);
+    a.sin6_addr = in6addr_any;
+    if(bind(fd_socket, (const sockaddr*)&a, sizeof(a)) == -1){
+      std::ostringstream os;
+      os << "bind([::]:" << client_port << ") failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+
+  if(kernel_drop_counter){
+    EnableKernelDropCounter(true);
+  }
+  if(kernel_timestamps){
+    EnableKernelTimestamps(true);
+  }
+  if(receive_buffer_size > 0){
+    SetReceiveBufferSize(receive_buffer_size, receive_buffer_force);
+  }
+  if(busy_poll_microseconds > 0){
+    SetBusyPoll(busy_poll_microseconds);
   }
 }
 
 void UDPClient::CloseSocket(){
   if(fd_socket){
- #if CLOSE_SOCKET_DELAY_SECONDS > 0
-    sleep(CLOSE_SOCKET_DELAY_SECONDS);
- #endif
+    if(close_delay_seconds > 0){
+      sleep(close_delay_seconds);
+    }
     close(fd_socket);
     fd_socket = 0;
   }
 }
 
+void UDPClient::Shutdown(){
+  shutting_down = true;
+  if(fd_socket){
+    // Makes a blocking recvfrom(2) return on Linux. On other platforms,
+    // the receiver sees the flag after its timeout expires.
+    shutdown(fd_socket, SHUT_RDWR);
+  }
+}
+
 void UDPClient::SetTimeout(unsigned long timeout_microsecond_){
   timeout_microsecond = timeout_microsecond_;
 
@@ -113,9 +333,242 @@ void UDPClient::SetTimeout(unsigned long timeout_microsecond_){
   }
 }
 
+void UDPClient::SetNonBlocking(bool nonblocking_){
+  int flags = fcntl(fd_socket, F_GETFL, 0);
+  if(flags == -1 ||
+     fcntl(fd_socket, F_SETFL,
+           nonblocking_ ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK)) == -1)
+  {
+    std::ostringstream os;
+    os << "fcntl(F_SETFL, O_NONBLOCK) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  nonblocking = nonblocking_;
+}
+
+void UDPClient::SetSocketFlag(int option, const char* name, bool enable){
+  if(fd_socket == 0){ // applied by OpenSocket
+    return;
+  }
+  int value = enable ? 1 : 0;
+  if(setsockopt(fd_socket, SOL_SOCKET, option, &value, sizeof(value)) == -1){
+    std::ostringstream os;
+    os << "setsockopt(SOL_SOCKET, " << name << ", " << value
+       << ", sizeof(int)) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPClient::EnableKernelDropCounter(bool enable){
+#ifdef SO_RXQ_OVFL
+  SetSocketFlag(SO_RXQ_OVFL, "SO_RXQ_OVFL", enable);
+  kernel_drop_counter = enable;
+#else
+  if(enable){
+    throw EXCEPTION("SO_RXQ_OVFL is not supported on this platform.");
+  }
+#endif
+}
+
+void UDPClient::EnableKernelTimestamps(bool enable){
+#ifdef SO_TIMESTAMPNS
+  SetSocketFlag(SO_TIMESTAMPNS, "SO_TIMESTAMPNS", enable);
+  kernel_timestamps = enable;
+#else
+  if(enable){
+    throw EXCEPTION("SO_TIMESTAMPNS is not supported on this platform.");
+  }
+#endif
+}
+
+size_t UDPClient::SetReceiveBufferSize(size_t bytes, bool force){
+  receive_buffer_size = bytes;
+  receive_buffer_force = force;
+  if(fd_socket == 0){ // applied by OpenSocket
+    return 0;
+  }
+  int value = bytes;
+  int rc = -1;
+#ifdef SO_RCVBUFFORCE
+  if(force){
+    rc = setsockopt(fd_socket, SOL_SOCKET, SO_RCVBUFFORCE, &value, sizeof(value));
+    if(rc == -1 && errno != EPERM){
+      std::ostringstream os;
+      os << "setsockopt(SOL_SOCKET, SO_RCVBUFFORCE, " << value
+         << ", sizeof(int)) failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+#endif
+  if(rc == -1 &&
+     setsockopt(fd_socket, SOL_SOCKET, SO_RCVBUF, &value, sizeof(value)) == -1)
+  {
+    std::ostringstream os;
+    os << "setsockopt(SOL_SOCKET, SO_RCVBUF, " << value
+       << ", sizeof(int)) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  return GetReceiveBufferSize();
+}
+
+size_t UDPClient::GetReceiveBufferSize() const {
+  if(fd_socket == 0){
+    return 0;
+  }
+  int value = 0;
+  socklen_t l = sizeof(value);
+  if(getsockopt(fd_socket, SOL_SOCKET, SO_RCVBUF, &value, &l) == -1){
+    std::ostringstream os;
+    os << "getsockopt(SOL_SOCKET, SO_RCVBUF) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  return value;
+}
+
+void UDPClient::SetBusyPoll(unsigned int microseconds){
+#ifdef SO_BUSY_POLL
+  if(fd_socket != 0){
+    int value = microseconds;
+    if(setsockopt(fd_socket, SOL_SOCKET, SO_BUSY_POLL, &value, sizeof(value)) == -1){
+      std::ostringstream os;
+      os << "setsockopt(SOL_SOCKET, SO_BUSY_POLL, " << value
+         << ", sizeof(int)) failed\n"
+         << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+  busy_poll_microseconds = microseconds;
+#else
+  if(microseconds > 0){
+    throw EXCEPTION("SO_BUSY_POLL is not supported on this platform.");
+  }
+#endif
+}
+
+void UDPClient::SetMembership(int option, uint32_t group, uint32_t interface,
+                              unsigned int interface_index)
+{
+  int rc = 0;
+  if(interface_index != 0){
+#if SBUTIL_IS_PLATFORM_LINUX
+    struct ip_mreqn mreqn;
+    memset(&mreqn, 0, sizeof(mreqn));
+    mreqn.imr_multiaddr.s_addr = htonl(group);
+    mreqn.imr_address.s_addr = htonl(interface);
+    mreqn.imr_ifindex = interface_index;
+    rc = setsockopt(fd_socket, IPPROTO_IP, option, &mreqn, sizeof(mreqn));
+#else
+    std::ostringstream os;
+    os << "Selecting interface " << interface_index << " for IPV4 multicast group "
+       << StringFromIPAddress(group) << " by index is not supported on this platform.";
+    throw EXCEPTION(os.str());
+#endif
+  }
+  else{
+    struct ip_mreq mreq;
+    memset(&mreq, 0, sizeof(mreq));
+    mreq.imr_multiaddr.s_addr = htonl(group);
+    mreq.imr_interface.s_addr = htonl(interface);
+    rc = setsockopt(fd_socket, IPPROTO_IP, option, &mreq, sizeof(mreq));
+  }
+  if(rc == -1){
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IP, "
+       << (option == IP_ADD_MEMBERSHIP ? "IP_ADD_MEMBERSHIP" : "IP_DROP_MEMBERSHIP")
+       << ", " << StringFromIPAddress(group) << ", "
+       << StringFromIPAddress(interface);
+    if(interface_index != 0){
+      os << ", interface " << interface_index;
+    }
+    os << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPClient::DisableMulticastAll(){
+#ifdef IP_MULTICAST_ALL
+  // Only deliver groups joined on this socket, not every group joined
+  // by any socket on the host with the same port. Kernels without the
+  // option behave as if it were off.
+  int zero = 0;
+  if(setsockopt(fd_socket, IPPROTO_IP, IP_MULTICAST_ALL, &zero, sizeof(zero)) == -1 &&
+     errno != ENOPROTOOPT)
+  {
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IP, IP_MULTICAST_ALL, 0) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+#endif
+}
+
+void UDPClient::JoinMulticastGroup(uint32_t group, uint32_t interface){
+  DisableMulticastAll();
+  SetMembership(IP_ADD_MEMBERSHIP, group, interface);
+}
+
+void UDPClient::LeaveMulticastGroup(uint32_t group, uint32_t interface){
+  SetMembership(IP_DROP_MEMBERSHIP, group, interface);
+}
+
+void UDPClient::SetMembership6(int option, const IPAddress& group,
+                               unsigned int interface_index)
+{
+  struct ipv6_mreq mreq;
+  memset(&mreq, 0, sizeof(mreq));
+  group.GetIPV6(mreq.ipv6mr_multiaddr.s6_addr);
+  mreq.ipv6mr_interface = interface_index;
+  if(setsockopt(fd_socket, IPPROTO_IPV6, option, &mreq, sizeof(mreq)) == -1){
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IPV6, "
+       << (option == IPV6_JOIN_GROUP ? "IPV6_JOIN_GROUP" : "IPV6_LEAVE_GROUP")
+       << ", " << group << ", " << interface_index << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPClient::JoinMulticastGroup(const IPAddress& group, unsigned int interface_index){
+  if(group.IsIPV4()){
+    DisableMulticastAll();
+    SetMembership(IP_ADD_MEMBERSHIP, group.GetIPV4(), 0u, interface_index);
+  }
+  else{
+    SetMembership6(IPV6_JOIN_GROUP, group, interface_index);
+  }
+}
+
+void UDPClient::LeaveMulticastGroup(const IPAddress& group, unsigned int interface_index){
+  if(group.IsIPV4()){
+    SetMembership(IP_DROP_MEMBERSHIP, group.GetIPV4(), 0u, interface_index);
+  }
+  else{
+    SetMembership6(IPV6_LEAVE_GROUP, group, interface_index);
+  }
+}
+
+void UDPClient::JoinMulticastGroup(const std::string& group,
+                                   uint32_t subnet, uint32_t netmask)
+{
+  JoinMulticastGroup(IPAddressFromString(group),
+                     GetLocalhostIPAddress(subnet, netmask));
+}
+
+void UDPClient::LeaveMulticastGroup(const std::string& group,
+                                    uint32_t subnet, uint32_t netmask)
+{
+  LeaveMulticastGroup(IPAddressFromString(group),
+                      GetLocalhostIPAddress(subnet, netmask));
+}
 
 UDPClient::receive_state_t UDPClient::ReceiveBlocking(UDPPacket& p, bool nothrow){
-  static uint8_t buf[MAX_UDP_PACKET_LENGTH];
+  uint8_t* buf = &receive_buffer[0];
 
   if(fd_socket == 0){ // socket not open
     if(nothrow){
@@ -125,16 +578,54 @@ UDPClient::receive_state_t UDPClient::ReceiveBlocking(UDPPacket& p, bool nothrow
       throw EXCEPTION("Socket not opened.");
     }
   }
+  if(shutting_down){
+    return receive_state_t::CLOSED;
+  }
 
-  sockaddr_in sender_socket_address;
+  // Large enough for either family.
+  sockaddr_in6 sender_socket_address;
   memset(&sender_socket_address, 0, sizeof(sender_socket_address));
-  socklen_t length = sizeof(sender_socket_address);
-  ssize_t n_bytes = recvfrom(fd_socket, buf, MAX_UDP_PACKET_LENGTH, 0,
-                             (sockaddr*) &sender_socket_address,
-                             &length);
+  struct iovec iov;
+  iov.iov_base = buf;
+  iov.iov_len = receive_buffer.size();
+  union {
+      struct cmsghdr align;
+      uint8_t data[CONTROL_SIZE];
+  } control;
+  struct msghdr header;
+  memset(&header, 0, sizeof(header));
+  header.msg_name = &sender_socket_address;
+  header.msg_namelen = sizeof(sender_socket_address);
+  header.msg_iov = &iov;
+  header.msg_iovlen = 1;
+  const bool want_control = kernel_timestamps || kernel_drop_counter;
+  if(want_control){
+    header.msg_control = control.data;
+    header.msg_controllen = sizeof(control.data);
+  }
+  ssize_t n_bytes = 0;
+  if(spin_receive){
+    const int64_t deadline =
+      timeout_microsecond > 0 ? monotonic_microseconds() + timeout_microsecond : 0;
+    while((n_bytes = recvmsg(fd_socket, &header, MSG_DONTWAIT)) == -1 &&
+          (errno == EAGAIN || errno == EWOULDBLOCK) && !shutting_down &&
+          (deadline == 0 || monotonic_microseconds() < deadline))
+    {
+      cpu_relax();
+    }
+  }
+  else{
+    n_bytes = recvmsg(fd_socket, &header, 0);
+  }
+
+  if(shutting_down){
+    return receive_state_t::CLOSED;
+  }
 
   // If the socket allows timeout, signal this.
-  if(timeout_microsecond > 0 && n_bytes == -1 && errno == EAGAIN){
+  if((timeout_microsecond > 0 || nonblocking || spin_receive) && n_bytes == -1 &&
+     (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
     return receive_state_t::TIMEOUT;
   }
 
@@ -146,17 +637,44 @@ UDPClient::receive_state_t UDPClient::ReceiveBlocking(UDPPacket& p, bool nothrow
     }
     else{
       std::ostringstream os;
-      os << "recvfrom() failed\n" << strerror(errno);
+      os << "recvmsg() failed\n" << strerror(errno);
       throw EXCEPTION(os.str());
     }
   }
 
+  if(statistics){
+    int64_t timestamp = 0;
+    uint32_t drops = 0;
+    if(want_control){
+      parse_control(&header, timestamp, drops);
+    }
+    statistics->AddPacket(buf, n_bytes, (header.msg_flags & MSG_TRUNC) != 0,
+                          timestamp, drops);
+  }
+
   p.SetData(buf, n_bytes);
-  p.SetAddress(inet_ntoa(sender_socket_address.sin_addr));
-  p.SetPort(ntohs(sender_socket_address.sin_port));
+  if(source_is_ipv4(sender_socket_address)){
+    p.SetAddress(source_ipv4(sender_socket_address));
+  }
+  else{
+    p.SetAddress(IPAddress(sender_socket_address.sin6_addr.s6_addr).ToString());
+  }
+  p.SetPort(source_port(sender_socket_address));
   // std::cerr << "ReceiveBlocking: " << std::string(buf, buf+n_bytes) << std::endl;
   // std::cerr << "ReceiveBlocking: " << p << std::endl;
 
+  if(header.msg_flags & MSG_TRUNC){
+    if(nothrow){
+      return receive_state_t::ERR_TRUNCATED;
+    }
+    else{
+      std::ostringstream os;
+      os << "Datagram from " << p.GetAddress() << ":" << p.GetPort()
+         << " longer than " << receive_buffer.size() << " bytes, truncated.";
+      throw EXCEPTION(os.str());
+    }
+  }
+
   if(!p.Deserialize(nothrow)){
     return receive_state_t::ERR_SERIALIZE;
   }
@@ -164,5 +682,100 @@ UDPClient::receive_state_t UDPClient::ReceiveBlocking(UDPPacket& p, bool nothrow
   return receive_state_t::OK;
 }
 
+UDPClient::receive_state_t UDPClient::ReceiveBatch(UDPReceiveBatch& batch, bool nothrow){
+  batch.size = 0;
+
+  if(fd_socket == 0){ // socket not open
+    if(nothrow){
+      return receive_state_t::ERR_SOCKET;
+    }
+    else{
+      throw EXCEPTION("Socket not opened.");
+    }
+  }
+  if(shutting_down){
+    return receive_state_t::CLOSED;
+  }
+
+#if SBUTIL_IS_PLATFORM_LINUX
+  // The kernel overwrites the address and control lengths and flags
+  // on return.
+  const bool want_control = kernel_timestamps || kernel_drop_counter;
+  for(size_t i=0; i<batch.capacity; ++i){
+    struct msghdr& h = batch.headers[i].msg_hdr;
+    h.msg_namelen = sizeof(struct sockaddr_in6);
+    h.msg_flags = 0;
+    h.msg_control = want_control ? &batch.control[i * CONTROL_SIZE] : NULL;
+    h.msg_controllen = want_control ? CONTROL_SIZE : 0;
+  }
+  int n = 0;
+  if(spin_receive){
+    const int64_t deadline =
+      timeout_microsecond > 0 ? monotonic_microseconds() + timeout_microsecond : 0;
+    while((n = recvmmsg(fd_socket, batch.headers, batch.capacity, MSG_DONTWAIT, NULL)) == -1 &&
+          (errno == EAGAIN || errno == EWOULDBLOCK) && !shutting_down &&
+          (deadline == 0 || monotonic_microseconds() < deadline))
+    {
+      cpu_relax();
+    }
+  }
+  else{
+    n = recvmmsg(fd_socket, batch.headers, batch.capacity, MSG_WAITFORONE, NULL);
+  }
+#else
+  socklen_t length = sizeof(struct sockaddr_in6);
+  ssize_t n_bytes = recvfrom(fd_socket, batch.iov[0].iov_base, batch.buffer_size,
+                             0, (sockaddr*)&batch.sources[0], &length);
+  int n = n_bytes == -1 ? -1 : 1;
+#endif
+
+  if(shutting_down){
+    return receive_state_t::CLOSED;
+  }
+
+  if((timeout_microsecond > 0 || nonblocking || spin_receive) && n == -1 &&
+     (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    return receive_state_t::TIMEOUT;
+  }
+  if(n == -1){
+    if(nothrow){
+      return receive_state_t::ERR_RECVFROM;
+    }
+    else{
+      std::ostringstream os;
+      os << "recvmmsg() failed\n" << strerror(errno);
+      throw EXCEPTION(os.str());
+    }
+  }
+
+  batch.size = n;
+  batch.drop_counter = 0;
+#if SBUTIL_IS_PLATFORM_LINUX
+  for(int i=0; i<n; ++i){
+    batch.lengths[i] = batch.headers[i].msg_len;
+    batch.truncated[i] = (batch.headers[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+    batch.timestamps[i] = 0;
+    if(want_control){
+      uint32_t drops = 0;
+      parse_control(&batch.headers[i].msg_hdr, batch.timestamps[i], drops);
+      // The counter only grows, modulo 2^32, so the last datagram that
+      // carried it has the current value.
+      if(drops != 0){
+        batch.drop_counter = drops;
+      }
+    }
+  }
+#else
+  batch.lengths[0] = n_bytes;
+  batch.truncated[0] = 0;
+  batch.timestamps[0] = 0;
+#endif
+
+  if(statistics){
+    statistics->AddBatch(batch);
+  }
+  return receive_state_t::OK;
+}
 
 // UDPClient.cc ends here
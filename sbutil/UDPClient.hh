@@ -1,16 +1,27 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-12 16:01:52 sb"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       UDPClient.hh
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
   Provides a simple wrapper around a "connectionless" socket that is
   bound to an IPV4 client_address at client_port. The socket can be
-  used to receive UDP packets using recvfrom.
+  used to receive UDP packets using recvfrom. Optionally, the socket
+  is bound to the IPV6 wildcard address instead, either for IPV6 only
+  or dual-stack, where IPV4 peers show up as IPV4-mapped addresses
+  and are reported as plain IPV4.
 
   Idea: instantiate one of these and call ReceiveBlocking.
 
+  For high packet rates, allocate a UDPReceiveBatch once and call
+  ReceiveBatch in a loop instead. On Linux, this fetches up to the
+  batch capacity of datagrams with a single recvmmsg(2) call into
+  preallocated buffers, without copying or formatting addresses.
+
+  To monitor loss and latency, attach a UDPStatistics with
+  SetStatistics, see UDPStatistics.hh.
+
 */
 
 
@@ -18,36 +29,229 @@
 #define UDPCLIENT_HH__F52FD72C_DA19_4450_A2DA_46ADADB36303
 
 #include <sbutil/UDPPacket.hh>
+#include <sbutil/IPUtilities.hh>
 #include <netinet/in.h>
+#include <atomic>
+
+struct iovec;
+struct mmsghdr;
+class UDPStatistics;
 
 // Windows maximal UDP packet length see
 // http://stackoverflow.com/questions/1098897/what-is-the-largest-safe-udp-packet-size-on-the-internet
 #define MAX_UDP_PACKET_LENGTH 65507
 
-// Wait before closing server socket to avoid TIME_WAIT errors
-#define CLOSE_SOCKET_DELAY_SECONDS 2
+// Largest UDP payload over IPV6 without jumbograms: 65535 bytes minus
+// the 8 byte UDP header. Also the size that fits any datagram of
+// either family.
+#define MAX_UDP6_PACKET_LENGTH 65527
+
+// Default for UDPClient::SetCloseDelay. UDP has no TIME_WAIT state, so
+// there is nothing to wait for by default.
+#define CLOSE_SOCKET_DELAY_SECONDS 0
 
 // Use SO_REUSEADDR?
 #define USE_SO_REUSEADDR 1
 
+// Reusable receive buffers for UDPClient::ReceiveBatch. Holds
+// GetCapacity() buffers of GetBufferSize() bytes each. After a call to
+// ReceiveBatch, entries 0 .. GetSize()-1 hold the received datagrams,
+// which stay valid until the next call.
+class UDPReceiveBatch {
+  private:
+    friend class UDPClient;
+
+    size_t capacity;
+    size_t buffer_size;
+    size_t size;
+    std::vector<uint8_t> storage;
+    std::vector<size_t> lengths;
+    std::vector<uint8_t> truncated;
+    std::vector<struct sockaddr_in6> sources; // or sockaddr_in
+    std::vector<uint8_t> control;
+    std::vector<int64_t> timestamps;
+    uint32_t drop_counter;
+    struct iovec* iov;
+    struct mmsghdr* headers; // Linux only
+
+    // make non-copyable
+    UDPReceiveBatch(const UDPReceiveBatch&);
+    UDPReceiveBatch& operator=(const UDPReceiveBatch&);
+
+  public:
+    // The default BUFFER_SIZE_ fits datagrams of either family.
+    UDPReceiveBatch(size_t capacity_,
+                    size_t buffer_size_ = MAX_UDP6_PACKET_LENGTH);
+    ~UDPReceiveBatch();
+
+    size_t GetCapacity() const {return capacity;}
+    size_t GetBufferSize() const {return buffer_size;}
+    size_t GetSize() const {return size;}
+
+    const uint8_t* GetData(size_t i) const {return &storage[i * buffer_size];}
+    size_t GetLength(size_t i) const {return lengths[i];}
+
+    // True if datagram I was longer than GetBufferSize() and has been
+    // cut off.
+    bool IsTruncated(size_t i) const {return truncated[i] != 0;}
+
+    // Source of datagram I, a sockaddr_in or sockaddr_in6 depending on
+    // the family of the client. Formatting the address is left to the
+    // caller, see GetAddress().
+    const struct sockaddr* GetSource(size_t i) const {
+      return reinterpret_cast<const struct sockaddr*>(&sources[i]);
+    }
+    // IPV4 source in host byte order, 0 for IPV6 sources.
+    uint32_t GetAddressHostOrder(size_t i) const;
+    IPAddress GetIPAddress(size_t i) const;
+    std::string GetAddress(size_t i) const;
+    unsigned short GetPort(size_t i) const;
+
+    // Time datagram I arrived at the socket, in nanoseconds since the
+    // UNIX Epoch, or 0 if UDPClient::EnableKernelTimestamps is off.
+    int64_t GetKernelTimestamp(size_t i) const {return timestamps[i];}
+
+    // Number of datagrams the kernel has dropped on this socket so far
+    // because its buffer was full, see
+    // UDPClient::EnableKernelDropCounter. 0 if none were reported.
+    uint32_t GetKernelDropCounter() const {return drop_counter;}
+
+    // Copy datagram I into P and call P.Deserialize(NOTHROW).
+    bool CopyTo(size_t i, UDPPacket& p, bool nothrow = false) const;
+};
+
+// Different UDPClient instances may receive concurrently on different
+// threads. A single instance must only be used by one thread at a
+// time.
 class UDPClient{
+  public:
+    typedef enum {
+      IPV4_ONLY,
+      IPV6_ONLY,
+      DUAL_STACK  // IPV6 socket that also receives IPV4
+    } family_t;
+
   private:
     int fd_socket;
+    family_t family;
     unsigned long timeout_microsecond;
+    unsigned int close_delay_seconds;
+    std::atomic<bool> shutting_down;
+    bool nonblocking;
+    bool reuse_port;
+    bool kernel_drop_counter;
+    bool kernel_timestamps;
+    size_t receive_buffer_size;
+    bool receive_buffer_force;
+    unsigned int busy_poll_microseconds;
+    bool spin_receive;
+    UDPStatistics* statistics;
+    std::vector<uint8_t> receive_buffer;
 
   protected:
     unsigned short client_port;
     struct sockaddr_in client_socket_address;
 
   public:
-    UDPClient(unsigned short port);
+    // If REUSE_PORT is set, bind with SO_REUSEPORT so that several
+    // clients, typically one per receiving thread, can share PORT. The
+    // kernel then distributes incoming datagrams between them by
+    // source address and port.
+    UDPClient(unsigned short port, bool reuse_port_ = false,
+              family_t family_ = IPV4_ONLY);
     virtual ~UDPClient();
 
     void OpenSocket();
+
+    // Close the socket immediately, or after the delay set with
+    // SetCloseDelay.
     void CloseSocket();
 
+    // Wake up a thread blocked in ReceiveBlocking or ReceiveBatch,
+    // which then returns CLOSED, and make all further receives return
+    // CLOSED. Safe to call from another thread. Join the receiving
+    // thread before calling CloseSocket().
+    void Shutdown();
+
+    // Sleep for SECONDS in CloseSocket() before closing.
+    void SetCloseDelay(unsigned int seconds) {close_delay_seconds = seconds;}
+
     void SetTimeout(unsigned long timeout_microsecond);
 
+    // In non-blocking mode, the receive functions return TIMEOUT
+    // immediately if no datagram is queued. Used by UDPReactor.
+    void SetNonBlocking(bool nonblocking_);
+    bool IsNonBlocking() const {return nonblocking;}
+
+    // Update STATISTICS_ on every successful receive. STATISTICS_ must
+    // outlive its use here, NULL turns this off.
+    void SetStatistics(UDPStatistics* statistics_) {statistics = statistics_;}
+    UDPStatistics* GetStatistics() const {return statistics;}
+
+    // Have the kernel report its count of datagrams dropped on this
+    // socket (SO_RXQ_OVFL), and the arrival time of every datagram
+    // (SO_TIMESTAMPNS), along with the received data. Linux only. The
+    // settings are kept when the socket is reopened.
+    void EnableKernelDropCounter(bool enable = true);
+    void EnableKernelTimestamps(bool enable = true);
+
+    // Ask for a kernel receive buffer of BYTES, so that bursts do not
+    // overflow it before they are picked up. SO_RCVBUF is capped at
+    // net.core.rmem_max; with FORCE, SO_RCVBUFFORCE ignores the cap but
+    // needs CAP_NET_ADMIN, and falls back to SO_RCVBUF without it.
+    // Returns the size the kernel actually granted, see
+    // GetReceiveBufferSize(), or 0 if the socket is not open. Kept when
+    // the socket is reopened.
+    size_t SetReceiveBufferSize(size_t bytes, bool force = false);
+
+    // Current kernel receive buffer size in bytes, 0 if the socket is
+    // not open. Linux reports twice the requested size, since it counts
+    // its bookkeeping overhead against the buffer.
+    size_t GetReceiveBufferSize() const;
+
+    // Busy-poll the device queue for up to MICROSECONDS before a
+    // blocking receive goes to sleep (SO_BUSY_POLL, Linux only, 0
+    // turns it off). Values above net.core.busy_read need
+    // CAP_NET_ADMIN. Kept when the socket is reopened.
+    void SetBusyPoll(unsigned int microseconds);
+
+    // In spin mode, the receive functions do not sleep in the kernel
+    // but poll the socket in a loop until a datagram arrives, the
+    // timeout set with SetTimeout expires, or Shutdown() is called.
+    // This trades a fully loaded core for the lowest wakeup latency;
+    // use it only on threads with a core to themselves.
+    void SetSpinReceive(bool spin) {spin_receive = spin;}
+    bool IsSpinReceive() const {return spin_receive;}
+
+    // Underlying socket descriptor, 0 if not open.
+    // Largest datagram the socket's family can carry, and the size of
+    // the buffer ReceiveBlocking uses: MAX_UDP_PACKET_LENGTH for
+    // IPV4_ONLY, MAX_UDP6_PACKET_LENGTH otherwise.
+    size_t GetMaxDatagramSize() const {return receive_buffer.size();}
+
+    int GetSocket() const {return fd_socket;}
+
+    // Receive datagrams sent to the IPV4 multicast GROUP on the
+    // client's port, through the local interface with address
+    // INTERFACE (host byte order, 0 lets the kernel choose). Several
+    // groups can be joined at the same time.
+    void JoinMulticastGroup(uint32_t group, uint32_t interface = 0);
+    void LeaveMulticastGroup(uint32_t group, uint32_t interface = 0);
+
+    // Join an IPV4 or IPV6 multicast GROUP through the interface with
+    // INTERFACE_INDEX (see if_nametoindex(3), 0 lets the kernel
+    // choose). For IPV6, the client must not be IPV4_ONLY. For IPV4, a
+    // nonzero index needs Linux and throws elsewhere.
+    void JoinMulticastGroup(const IPAddress& group, unsigned int interface_index);
+    void LeaveMulticastGroup(const IPAddress& group, unsigned int interface_index);
+
+    // Same, with GROUP as a string and the interface chosen with
+    // GetLocalhostIPAddress(SUBNET, NETMASK), see IPUtilities.hh.
+    void JoinMulticastGroup(const std::string& group,
+                            uint32_t subnet, uint32_t netmask);
+    void LeaveMulticastGroup(const std::string& group,
+                             uint32_t subnet, uint32_t netmask);
+
     // Since receiving of packets over the network can produce errors
     // that are not the result of programmer brain damage, we can turn
     // off the usual exception throwing on errors by setting nothrow =
@@ -56,13 +260,30 @@ class UDPClient{
     //
     typedef enum {
       OK,            // everything worked
-      TIMEOUT,       // timeout was set, and socket timed out
+      TIMEOUT,       // timeout was set, and socket timed out, or
+                     // non-blocking and no datagram queued
       ERR_SOCKET,    // socket not open
       ERR_RECVFROM,  // other error from recvfrom
-      ERR_SERIALIZE  // error from UDPPacket::Deserialize
+      ERR_SERIALIZE, // error from UDPPacket::Deserialize
+      ERR_TRUNCATED, // datagram longer than GetMaxDatagramSize(), the
+                     // packet holds the cut-off data, not deserialized
+      CLOSED         // Shutdown() was called
       } receive_state_t;
 
     receive_state_t ReceiveBlocking(UDPPacket& p, bool nothrow = false);
+
+    // Block until at least one datagram arrives, or the timeout
+    // expires, then receive as many datagrams as are queued, up to
+    // BATCH.GetCapacity(). Outside of Linux, receives one datagram per
+    // call. Datagrams are not deserialized.
+    receive_state_t ReceiveBatch(UDPReceiveBatch& batch, bool nothrow = false);
+
+  private:
+    void SetMembership(int option, uint32_t group, uint32_t interface,
+                       unsigned int interface_index = 0);
+    void DisableMulticastAll();
+    void SetSocketFlag(int option, const char* name, bool enable);
+    void SetMembership6(int option, const IPAddress& group, unsigned int interface_index);
 };
 
 
@@ -1,19 +1,22 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-12 16:22:06 sb"
+// Time-stamp: "2026-10-19 13:20:14 sb"
 
 /*
   file       UDPPacket.cc
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
  */
 
 #include <sbutil/UDPPacket.hh>
+#include <sbutil/IPUtilities.hh>
 #include <sbutil/OutputManipulator.hh>
 
 const UDPPacket& UDPPacket::Assign(const UDPPacket& x) {
-  data = x.GetData();
-  address = x.GetAddress();
-  port = x.GetPort();
+  data = x.data;
+  address = x.address;
+  address_is_raw = x.address_is_raw;
+  raw_address = x.raw_address;
+  port = x.port;
   return *this;
 }
 
@@ -22,23 +25,30 @@ const UDPPacket& UDPPacket::Assign(const std::vector<uint8_t>& data_,
                                    unsigned short port_)
 {
   data = data_;
-  address = address_;
+  SetAddress(address_);
   port = port_;
   return *this;
 }
 
 void UDPPacket::Clear(){
   data.clear();
-  address.clear();
+  SetAddress("");
   port = 0;
 }
 
+// Formats on every call rather than caching, so that const access
+// stays free of writes and a packet can be shared between threads.
+std::string UDPPacket::GetAddress() const {
+  return address_is_raw ? StringFromIPAddress(raw_address) : address;
+}
+
 
 
 std::ostream& UDPPacket::Represent(std::ostream& out) const {
   out << "UDP Packet";
-  if(port != 0 && !address.empty()){
-    out << " with address " << address << ":" << port << "\n";
+  const std::string a = GetAddress();
+  if(port != 0 && !a.empty()){
+    out << " with address " << a << ":" << port << "\n";
   }
   else{
     out << " without address information.\n";
@@ -1,9 +1,9 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-12 15:55:25 sb"
+// Time-stamp: "2026-10-19 15:06:12 sb"
 
 /*
   file       UDPPacket.hh
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
   Base class for UDP Packets that contains a binary data vector and
   address:port information for IPV4.
@@ -16,7 +16,9 @@
   UDPClient::ReceiveBlocking to raise your special format from binary.
 
   You must make sure *by* *hand* that Serialize/Deserialize assume
-  network byte order (most significant byte first).
+  network byte order (most significant byte first), or derive from
+  TypedUDPPacket in Serializer.hh, which generates both from a field
+  list.
 
   Make sure that your child classes remain copyable, and call the
   Assign functions in the derived class!
@@ -40,7 +42,13 @@ class UDPPacket : public Representable {
     // UDPClient::ReceiveBlocking to contain the *source* IP address and
     // port. For UDPServer::SendPacket, these are used as the *target*
     // address and port.
+    //
+    // Received IPV4 addresses are stored as a number in host byte order
+    // in RAW_ADDRESS, with ADDRESS_IS_RAW set, and only formatted when
+    // GetAddress() is called.
     std::string address;
+    bool address_is_raw;
+    uint32_t raw_address;
     unsigned short port;
 
   public:
@@ -52,17 +60,22 @@ class UDPPacket : public Representable {
 
 
     UDPPacket()
-      : data(), address(), port(0)
+      : data(), address(), address_is_raw(false), raw_address(0), port(0)
     {}
     UDPPacket(const std::vector<uint8_t>& data_,
               const std::string& address_ = "",
               unsigned short port_ = 0)
-      : data(data_), address(address_), port(port_)
+      : data(data_), address(address_), address_is_raw(false),
+        raw_address(0), port(port_)
     {
       Assign(data_, address_, port_);
     }
 
-    UDPPacket(const UDPPacket& x) : data(), address(), port(0) {Assign(x);}
+    UDPPacket(const UDPPacket& x)
+      : data(), address(), address_is_raw(false), raw_address(0), port(0)
+    {
+      Assign(x);
+    }
     const UDPPacket& operator=(const UDPPacket& x) {return Assign(x);}
 
     virtual ~UDPPacket(){}
@@ -70,11 +83,21 @@ class UDPPacket : public Representable {
     const std::vector<uint8_t>& GetData() const {return data;}
     void SetData(const std::vector<uint8_t>& data_){data = data_;}
     void SetData(const uint8_t* buf, size_t length){
-      data.clear();
-      std::copy(buf, buf+length, std::back_inserter(data));
+      data.assign(buf, buf+length);
+    }
+    std::string GetAddress() const;
+    void SetAddress(const std::string& address_) {
+      address = address_;
+      address_is_raw = false;
+      raw_address = 0;
+    }
+    // Set the IPV4 address from a number in host byte order without
+    // formatting it.
+    void SetAddress(uint32_t address_in_host_byte_order) {
+      address.clear();
+      address_is_raw = true;
+      raw_address = address_in_host_byte_order;
     }
-    const std::string& GetAddress() const {return address;}
-    void SetAddress(const std::string& address_) {address = address_;}
     unsigned short GetPort() const {return port;}
     void SetPort(unsigned short port_) {port = port_;}
 
@@ -0,0 +1,222 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 14:25:08 sb"
+
+/*
+  file       UDPReactor.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/Platform.hh>
+
+#include <sstream>
+#include <cstring>
+
+#include <errno.h>
+#include <unistd.h>
+
+#if SBUTIL_IS_PLATFORM_LINUX
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
+#include <sbutil/UDPReactor.hh>
+#include <sbutil/Exception.hh>
+
+// Events fetched per epoll_wait(2) call.
+static const int MAX_EPOLL_EVENTS = 64;
+
+UDPReactor::UDPReactor(size_t batch_capacity, size_t buffer_size)
+  : fd_epoll(-1),
+    fd_wakeup(-1),
+    stop_requested(false),
+    batch(batch_capacity, buffer_size),
+    entries()
+{
+#if SBUTIL_IS_PLATFORM_LINUX
+  if((fd_epoll = epoll_create1(EPOLL_CLOEXEC)) == -1){
+    std::ostringstream os;
+    os << "epoll_create1() failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  if((fd_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1){
+    std::ostringstream os;
+    os << "eventfd() failed\n"
+       << strerror(errno);
+    close(fd_epoll);
+    throw EXCEPTION(os.str());
+  }
+  // The wakeup descriptor is registered without an entry.
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd_wakeup;
+  if(epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd_wakeup, &ev) == -1){
+    std::ostringstream os;
+    os << "epoll_ctl(EPOLL_CTL_ADD, eventfd) failed\n"
+       << strerror(errno);
+    close(fd_wakeup);
+    close(fd_epoll);
+    throw EXCEPTION(os.str());
+  }
+#else
+  throw EXCEPTION("UDPReactor requires epoll(7), which is Linux only.");
+#endif
+}
+
+UDPReactor::~UDPReactor(){
+  if(fd_wakeup != -1){
+    close(fd_wakeup);
+  }
+  if(fd_epoll != -1){
+    close(fd_epoll);
+  }
+}
+
+void UDPReactor::Register(int fd, uint32_t events,
+                          const std::shared_ptr<Entry>& entry)
+{
+#if SBUTIL_IS_PLATFORM_LINUX
+  if(entries.count(fd)){
+    std::ostringstream os;
+    os << "Descriptor " << fd << " already registered.";
+    throw EXCEPTION(os.str());
+  }
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = events | EPOLLET;
+  ev.data.fd = fd;
+  if(epoll_ctl(fd_epoll, EPOLL_CTL_ADD, fd, &ev) == -1){
+    std::ostringstream os;
+    os << "epoll_ctl(EPOLL_CTL_ADD, " << fd << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  entries[fd] = entry;
+#else
+  (void)fd;
+  (void)events;
+  (void)entry;
+#endif
+}
+
+void UDPReactor::Add(UDPClient& client, const packet_callback_t& on_packets){
+  if(client.GetSocket() == 0){
+    throw EXCEPTION("Socket not opened.");
+  }
+  std::shared_ptr<Entry> e(new Entry);
+  e->client = &client;
+  e->on_packets = on_packets;
+  client.SetNonBlocking(true);
+#if SBUTIL_IS_PLATFORM_LINUX
+  Register(client.GetSocket(), EPOLLIN, e);
+#endif
+  // Datagrams that arrived before registration do not produce an
+  // edge, pick them up right away.
+  Drain(e);
+}
+
+void UDPReactor::Remove(UDPClient& client){
+  RemoveDescriptor(client.GetSocket());
+}
+
+void UDPReactor::AddDescriptor(int fd, uint32_t events,
+                               const event_callback_t& on_event)
+{
+  std::shared_ptr<Entry> e(new Entry);
+  e->client = NULL;
+  e->on_event = on_event;
+  Register(fd, events, e);
+}
+
+void UDPReactor::RemoveDescriptor(int fd){
+  std::map<int, std::shared_ptr<Entry> >::iterator it = entries.find(fd);
+  if(it == entries.end()){
+    return;
+  }
+  entries.erase(it);
+#if SBUTIL_IS_PLATFORM_LINUX
+  // Fails harmlessly if FD has already been closed.
+  struct epoll_event ev;
+  epoll_ctl(fd_epoll, EPOLL_CTL_DEL, fd, &ev);
+#endif
+}
+
+void UDPReactor::Drain(const std::shared_ptr<Entry>& entry){
+  UDPClient& client = *entry->client;
+  const int fd = client.GetSocket();
+  // Stop when the socket is empty, fails, or the callback removed
+  // the registration.
+  while(client.ReceiveBatch(batch, true) == UDPClient::OK){
+    entry->on_packets(client, batch);
+    std::map<int, std::shared_ptr<Entry> >::const_iterator it = entries.find(fd);
+    if(it == entries.end() || it->second != entry){
+      break;
+    }
+  }
+}
+
+size_t UDPReactor::RunOnce(int timeout_millisecond){
+#if SBUTIL_IS_PLATFORM_LINUX
+  struct epoll_event events[MAX_EPOLL_EVENTS];
+  int n = epoll_wait(fd_epoll, events, MAX_EPOLL_EVENTS, timeout_millisecond);
+  if(n == -1){
+    if(errno == EINTR){
+      return 0;
+    }
+    std::ostringstream os;
+    os << "epoll_wait() failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+
+  size_t serviced = 0;
+  for(int i=0; i<n; ++i){
+    const int fd = events[i].data.fd;
+    if(fd == fd_wakeup){
+      uint64_t count;
+      while(read(fd_wakeup, &count, sizeof(count)) > 0){}
+      continue;
+    }
+    std::map<int, std::shared_ptr<Entry> >::const_iterator it = entries.find(fd);
+    if(it == entries.end()){ // removed by an earlier callback
+      continue;
+    }
+    // Keep the entry alive even if the callback removes it.
+    std::shared_ptr<Entry> e = it->second;
+    if(e->client){
+      Drain(e);
+    }
+    else{
+      e->on_event(fd, events[i].events);
+    }
+    ++serviced;
+  }
+  return serviced;
+#else
+  (void)timeout_millisecond;
+  return 0;
+#endif
+}
+
+void UDPReactor::Run(){
+  while(!stop_requested){
+    RunOnce(-1);
+  }
+  // allow calling Run() again
+  stop_requested = false;
+}
+
+void UDPReactor::Stop(){
+  stop_requested = true;
+  const uint64_t one = 1;
+  if(write(fd_wakeup, &one, sizeof(one)) == -1 && errno != EAGAIN){
+    std::ostringstream os;
+    os << "write(eventfd) failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+// UDPReactor.cc ends here
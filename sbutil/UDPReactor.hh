@@ -0,0 +1,94 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 14:25:08 sb"
+
+/*
+  file       UDPReactor.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Service many UDPClient sockets, and other file descriptors, from a
+  single thread with one epoll(7) instance.
+
+  Registered clients are switched to non-blocking mode and watched
+  edge-triggered. When a socket becomes readable, the reactor drains
+  it with UDPClient::ReceiveBatch and passes each batch to the
+  client's callback. The batch buffers are shared between all clients
+  and are only valid during the callback.
+
+  Callbacks run on the thread calling Run() or RunOnce() and may add
+  or remove registrations. Stop() may be called from any thread.
+
+  Linux only. Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef UDPREACTOR_HH__E3ECCEF5_580E_4F53_BB06_DE5BFE5D2EC7
+#define UDPREACTOR_HH__E3ECCEF5_580E_4F53_BB06_DE5BFE5D2EC7
+
+#include <sbutil/UDPClient.hh>
+
+#include <map>
+#include <atomic>
+#include <memory>
+#include <functional>
+
+class UDPReactor {
+  public:
+    typedef std::function<void(UDPClient&, const UDPReceiveBatch&)> packet_callback_t;
+    typedef std::function<void(int, uint32_t)> event_callback_t;
+
+  private:
+    struct Entry {
+        UDPClient* client;
+        packet_callback_t on_packets;
+        event_callback_t on_event;
+    };
+
+    int fd_epoll;
+    int fd_wakeup;
+    std::atomic<bool> stop_requested;
+    UDPReceiveBatch batch;
+    std::map<int, std::shared_ptr<Entry> > entries;
+
+    // make non-copyable
+    UDPReactor(const UDPReactor&);
+    UDPReactor& operator=(const UDPReactor&);
+
+    void Register(int fd, uint32_t events, const std::shared_ptr<Entry>& entry);
+    void Drain(const std::shared_ptr<Entry>& entry);
+
+  public:
+    // Receive up to BATCH_CAPACITY datagrams of at most BUFFER_SIZE
+    // bytes per system call.
+    UDPReactor(size_t batch_capacity = 32,
+               size_t buffer_size = MAX_UDP6_PACKET_LENGTH);
+    ~UDPReactor();
+
+    // Call ON_PACKETS for every batch received on CLIENT. CLIENT must
+    // stay open and outlive its registration.
+    void Add(UDPClient& client, const packet_callback_t& on_packets);
+    void Remove(UDPClient& client);
+
+    // Call ON_EVENT(FD, EVENTS) when FD signals any of EVENTS
+    // (EPOLLIN, EPOLLOUT, ...). FD is watched edge-triggered, so it
+    // should be non-blocking and the callback must consume everything
+    // that is pending.
+    void AddDescriptor(int fd, uint32_t events, const event_callback_t& on_event);
+    void RemoveDescriptor(int fd);
+
+    size_t GetSize() const {return entries.size();}
+
+    // Wait up to TIMEOUT_MILLISECOND (-1: forever) for events and
+    // dispatch them. Return the number of descriptors serviced.
+    size_t RunOnce(int timeout_millisecond = -1);
+
+    // Dispatch events until Stop() is called.
+    void Run();
+
+    // Make Run() return after the current dispatch round. Thread-safe.
+    void Stop();
+};
+
+#endif // UDPREACTOR_HH__E3ECCEF5_580E_4F53_BB06_DE5BFE5D2EC7
+
+// UDPReactor.hh ends here
@@ -1,14 +1,15 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2018-03-14 15:26:42 srlab"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       UDPServer.cc
-  copyright  (c) Sebastian Blatt 2012 -- 2018
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
  */
 
 #include <sbutil/Platform.hh>
 
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <cstdio>
@@ -16,6 +17,7 @@
 
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 
 #if SBUTIL_IS_PLATFORM_POSIX
@@ -24,10 +26,75 @@
 
 #include <sbutil/Exception.hh>
 #include <sbutil/UDPServer.hh>
+#include <sbutil/IPUtilities.hh>
 #include <sbutil/OutputManipulator.hh>
 
+// -------------------------------------------------------------- UDPDestination
+
+UDPDestination::UDPDestination(){
+  memset(&socket_address, 0, sizeof(socket_address));
+  socket_address.v4.sin_family = AF_INET;
+}
+
+UDPDestination::UDPDestination(const std::string& address, unsigned short port){
+  memset(&socket_address, 0, sizeof(socket_address));
+  socket_address.v4.sin_family = AF_INET;
+  socket_address.v4.sin_port = htons(port);
+  if(inet_aton(address.c_str(), &socket_address.v4.sin_addr) == 0){
+    *this = UDPDestination(IPAddress(address), port);
+  }
+}
+
+UDPDestination::UDPDestination(uint32_t address_in_host_byte_order,
+                               unsigned short port)
+{
+  memset(&socket_address, 0, sizeof(socket_address));
+  socket_address.v4.sin_family = AF_INET;
+  socket_address.v4.sin_port = htons(port);
+  socket_address.v4.sin_addr.s_addr = htonl(address_in_host_byte_order);
+}
+
+UDPDestination::UDPDestination(const IPAddress& address, unsigned short port){
+  memset(&socket_address, 0, sizeof(socket_address));
+  if(address.IsIPV4()){
+    socket_address.v4.sin_family = AF_INET;
+    socket_address.v4.sin_port = htons(port);
+    socket_address.v4.sin_addr.s_addr = htonl(address.GetIPV4());
+  }
+  else{
+    socket_address.v6.sin6_family = AF_INET6;
+    socket_address.v6.sin6_port = htons(port);
+    address.GetIPV6(socket_address.v6.sin6_addr.s6_addr);
+  }
+}
+
+std::string UDPDestination::GetAddress() const {
+  if(IsIPV6()){
+    return GetIPAddress().ToString();
+  }
+  return StringFromIPAddress(GetAddressHostOrder());
+}
+
+IPAddress UDPDestination::GetIPAddress() const {
+  if(IsIPV6()){
+    return IPAddress(socket_address.v6.sin6_addr.s6_addr);
+  }
+  return IPAddress(GetAddressHostOrder());
+}
+
+uint32_t UDPDestination::GetAddressHostOrder() const {
+  return IsIPV6() ? 0 : ntohl(socket_address.v4.sin_addr.s_addr);
+}
+
+unsigned short UDPDestination::GetPort() const {
+  return ntohs(IsIPV6() ? socket_address.v6.sin6_port : socket_address.v4.sin_port);
+}
+
+// ------------------------------------------------------------------- UDPServer
+
 UDPServer::UDPServer()
-  : fd_socket(0)
+  : fd_socket(0),
+    fd_socket6(0)
 {
   OpenSocket();
 }
@@ -47,6 +114,11 @@ void UDPServer::OpenSocket(){
        << strerror(errno);
     throw EXCEPTION(os.str());
   }
+
+  // Without IPV6 support, sending to IPV6 targets fails later.
+  if((fd_socket6 = socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP)) == -1){
+    fd_socket6 = 0;
+  }
 }
 
 void UDPServer::CloseSocket(){
@@ -54,6 +126,63 @@ void UDPServer::CloseSocket(){
       close(fd_socket);
       fd_socket = 0;
   }
+  if(fd_socket6){
+      close(fd_socket6);
+      fd_socket6 = 0;
+  }
+}
+
+void UDPServer::SetMulticastTTL(unsigned char ttl){
+  if(setsockopt(fd_socket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) == -1){
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IP, IP_MULTICAST_TTL, " << (int)ttl << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  int hops = ttl;
+  if(fd_socket6 &&
+     setsockopt(fd_socket6, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops)) == -1)
+  {
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IPV6, IPV6_MULTICAST_HOPS, " << hops << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPServer::SetMulticastLoopback(bool loopback){
+  unsigned char l = loopback ? 1 : 0;
+  if(setsockopt(fd_socket, IPPROTO_IP, IP_MULTICAST_LOOP, &l, sizeof(l)) == -1){
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IP, IP_MULTICAST_LOOP, " << (int)l << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+  unsigned int l6 = l;
+  if(fd_socket6 &&
+     setsockopt(fd_socket6, IPPROTO_IPV6, IPV6_MULTICAST_LOOP, &l6, sizeof(l6)) == -1)
+  {
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IPV6, IPV6_MULTICAST_LOOP, " << l6 << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPServer::SetMulticastInterface(uint32_t interface){
+  struct in_addr a;
+  a.s_addr = htonl(interface);
+  if(setsockopt(fd_socket, IPPROTO_IP, IP_MULTICAST_IF, &a, sizeof(a)) == -1){
+    std::ostringstream os;
+    os << "setsockopt(IPPROTO_IP, IP_MULTICAST_IF, "
+       << StringFromIPAddress(interface) << ") failed\n"
+       << strerror(errno);
+    throw EXCEPTION(os.str());
+  }
+}
+
+void UDPServer::SetMulticastInterface(uint32_t subnet, uint32_t netmask){
+  SetMulticastInterface(GetLocalhostIPAddress(subnet, netmask));
 }
 
 bool UDPServer::SendPacket(const std::string& target_address,
@@ -77,6 +206,12 @@ bool UDPServer::SendPacket(const std::string& target_address,
   target.sin_port = htons(target_port);
 
   if(inet_aton(target_address.c_str(), &target.sin_addr) == 0){
+    // Not IPV4, the slower path parses IPV6.
+    struct in6_addr a6;
+    if(inet_pton(AF_INET6, target_address.c_str(), &a6) == 1){
+      return SendPacket(UDPDestination(IPAddress(a6.s6_addr), target_port),
+                        data, length, nothrow);
+    }
     if(nothrow){
       return false;
     }
@@ -109,7 +244,131 @@ bool UDPServer::SendPacket(const std::string& target_address,
   return true;
 }
 
+bool UDPServer::SendPacket(const UDPDestination& destination,
+                           const char* data,
+                           size_t length,
+                           bool nothrow) const
+{
+  UDPMessage m(destination, data, length);
+  return SendBatch(&m, 1, nothrow) == 1;
+}
+
+size_t UDPServer::SendBatch(const UDPMessage* messages,
+                            size_t n_messages,
+                            bool nothrow) const
+{
+  if(fd_socket == 0){
+    if(nothrow){
+      return 0;
+    }
+    else{
+      throw EXCEPTION("Socket not open.");
+    }
+  }
+
+  size_t sent = 0;
+  while(sent < n_messages){
+    const UDPMessage* m = messages + sent;
+    // Each system call goes to one socket, so split the batch where the
+    // address family changes.
+    const bool v6 = m[0].destination->IsIPV6();
+    const size_t limit = std::min<size_t>(n_messages - sent, UDP_SEND_BATCH);
+    size_t n = 1;
+    while(n < limit && m[n].destination->IsIPV6() == v6){
+      ++n;
+    }
+    const int fd = v6 ? fd_socket6 : fd_socket;
+    if(fd == 0){
+      if(nothrow){
+        return sent;
+      }
+      throw EXCEPTION("IPV6 is not available on this host.");
+    }
+    int rc;
+
+#if SBUTIL_IS_PLATFORM_LINUX
+    struct iovec iov[UDP_SEND_BATCH];
+    struct mmsghdr headers[UDP_SEND_BATCH];
+    memset(headers, 0, n * sizeof(struct mmsghdr));
+    for(size_t i=0; i<n; ++i){
+      iov[i].iov_base = const_cast<void*>(m[i].data);
+      iov[i].iov_len = m[i].length;
+      headers[i].msg_hdr.msg_name =
+        const_cast<struct sockaddr*>(m[i].destination->GetSocketAddress());
+      headers[i].msg_hdr.msg_namelen = m[i].destination->GetSocketAddressLength();
+      headers[i].msg_hdr.msg_iov = &iov[i];
+      headers[i].msg_hdr.msg_iovlen = 1;
+    }
+    rc = sendmmsg(fd, headers, n, 0);
+#else
+    rc = sendto(fd, m[0].data, m[0].length, 0,
+                m[0].destination->GetSocketAddress(),
+                m[0].destination->GetSocketAddressLength()) == -1 ? -1 : 1;
+#endif
 
+    if(rc == -1){
+      if(nothrow){
+        return sent;
+      }
+      else{
+        std::ostringstream os;
+        os << "sendmmsg(" << m[0].destination->GetAddress() << ":"
+           << m[0].destination->GetPort() << ") failed after "
+           << sent << " of " << n_messages << " datagrams\n"
+           << strerror(errno);
+        throw EXCEPTION(os.str());
+      }
+    }
+    sent += rc;
+  }
+  return sent;
+}
 
+size_t UDPServer::SendToAll(const std::vector<UDPDestination>& destinations,
+                            const char* data,
+                            size_t length,
+                            bool nothrow) const
+{
+  UDPMessage m[UDP_SEND_BATCH];
+  size_t sent = 0;
+  for(size_t i=0; i<destinations.size(); i+=UDP_SEND_BATCH){
+    const size_t n = std::min<size_t>(destinations.size() - i, UDP_SEND_BATCH);
+    for(size_t j=0; j<n; ++j){
+      m[j] = UDPMessage(destinations[i + j], data, length);
+    }
+    const size_t rc = SendBatch(m, n, nothrow);
+    sent += rc;
+    if(rc < n){
+      break;
+    }
+  }
+  return sent;
+}
+
+size_t UDPServer::SendPackets(UDPPacket* const* packets,
+                              size_t n_packets,
+                              const UDPDestination& destination,
+                              bool nothrow) const
+{
+  UDPMessage m[UDP_SEND_BATCH];
+  size_t sent = 0;
+  for(size_t i=0; i<n_packets; i+=UDP_SEND_BATCH){
+    const size_t n = std::min<size_t>(n_packets - i, UDP_SEND_BATCH);
+    for(size_t j=0; j<n; ++j){
+      UDPPacket& p = *packets[i + j];
+      if(!p.Serialize(nothrow)){
+        return sent + SendBatch(m, j, nothrow);
+      }
+      const std::vector<uint8_t>& d = p.GetData();
+      m[j] = UDPMessage(destination, d.empty() ? NULL : &d[0], d.size());
+    }
+    const size_t rc = SendBatch(m, n, nothrow);
+    sent += rc;
+    if(rc < n){
+      break;
+    }
+  }
+  return sent;
+}
 
 // UDPServer.cc ends here
@@ -1,15 +1,21 @@
 // -*- mode: C++ -*-
-// Time-stamp: "2016-02-12 16:01:42 sb"
+// Time-stamp: "2026-10-19 18:05:51 sb"
 
 /*
   file       UDPServer.hh
-  copyright  (c) Sebastian Blatt 2012 -- 2016
+  copyright  (c) Sebastian Blatt 2012 -- 2026
 
   Provides a simple wrapper around an unbound connectionless socket
   that can be used to send UDP packets to arbitrary IPV4 addresses.
+  IPV6 targets are sent through a second socket, which is opened
+  alongside if the host supports IPV6.
 
   Idea: instantiate one of these and call SendPacket.
 
+  For many datagrams or many receivers, resolve each target once into
+  a UDPDestination and use SendBatch or SendToAll, which hand up to
+  UDP_SEND_BATCH datagrams to the kernel in a single sendmmsg(2) call
+  on Linux.
 
 */
 
@@ -18,11 +24,60 @@
 #define UDPSERVER_HH__B7CA5A67_6C37_42DF_A4F5_9D21373080F8
 
 #include <sbutil/UDPPacket.hh>
+#include <sbutil/IPUtilities.hh>
 #include <stdint.h>
+#include <netinet/in.h>
+
+// Number of datagrams passed to one sendmmsg(2) call.
+#define UDP_SEND_BATCH 64
+
+// Pre-resolved IPV4 or IPV6 target address and port.
+class UDPDestination {
+  private:
+    union {
+        struct sockaddr_in v4;
+        struct sockaddr_in6 v6;
+    } socket_address;
+
+  public:
+    UDPDestination();
+    // Throws if ADDRESS is not a valid IPV4 or IPV6 address.
+    UDPDestination(const std::string& address, unsigned short port);
+    UDPDestination(uint32_t address_in_host_byte_order, unsigned short port);
+    UDPDestination(const IPAddress& address, unsigned short port);
+
+    std::string GetAddress() const;
+    IPAddress GetIPAddress() const;
+    // 0 for IPV6 destinations.
+    uint32_t GetAddressHostOrder() const;
+    unsigned short GetPort() const;
+    bool IsIPV6() const {return socket_address.v4.sin_family == AF_INET6;}
+
+    const struct sockaddr* GetSocketAddress() const {
+      return reinterpret_cast<const struct sockaddr*>(&socket_address);
+    }
+    socklen_t GetSocketAddressLength() const {
+      return IsIPV6() ? sizeof(socket_address.v6) : sizeof(socket_address.v4);
+    }
+};
+
+// One datagram for UDPServer::SendBatch. Nothing is copied, DATA must
+// stay valid during the call.
+struct UDPMessage {
+    const UDPDestination* destination;
+    const void* data;
+    size_t length;
+
+    UDPMessage()
+      : destination(NULL), data(NULL), length(0) {}
+    UDPMessage(const UDPDestination& destination_, const void* data_, size_t length_)
+      : destination(&destination_), data(data_), length(length_) {}
+};
 
 class UDPServer {
   private:
     int fd_socket;
+    int fd_socket6; // 0 if IPV6 is not available
 
   public:
     UDPServer();
@@ -31,6 +86,22 @@ class UDPServer {
     void OpenSocket();
     void CloseSocket();
 
+    // Multicast options for all datagrams sent to group addresses. A
+    // single send reaches every subscriber of the group.
+    //
+    // TTL: number of router hops, 1 (default) stays on the local
+    // network. LOOPBACK: whether subscribers on this host receive the
+    // datagrams, default true. These two apply to IPV4 and IPV6.
+    // INTERFACE: address of the outgoing local IPV4 interface in host
+    // byte order, 0 lets the routing table decide.
+    void SetMulticastTTL(unsigned char ttl);
+    void SetMulticastLoopback(bool loopback);
+    void SetMulticastInterface(uint32_t interface);
+
+    // Send through the interface found by GetLocalhostIPAddress(SUBNET,
+    // NETMASK), see IPUtilities.hh.
+    void SetMulticastInterface(uint32_t subnet, uint32_t netmask);
+
     // The nothrow parameter can be used to prevent Exception handling
     // for performance reasons. Downside: only boolean value is
     // returned.
@@ -86,6 +157,53 @@ class UDPServer {
                         packet.GetData(),
                         nothrow);
     }
+
+    // Send to a pre-resolved DESTINATION, ignoring the address stored
+    // in PACKET.
+    bool SendPacket(const UDPDestination& destination,
+                    const char* data,
+                    size_t length,
+                    bool nothrow = false) const;
+
+    bool SendPacket(const UDPDestination& destination,
+                    UDPPacket& packet,
+                    bool nothrow = false) const {
+      if(!packet.Serialize(nothrow)){
+        return false;
+      }
+      const std::vector<uint8_t>& d = packet.GetData();
+      return SendPacket(destination,
+                        reinterpret_cast<const char*>(d.empty() ? NULL : &d[0]),
+                        d.size(),
+                        nothrow);
+    }
+
+    // Send N_MESSAGES datagrams with as few system calls as
+    // possible. Return the number of datagrams sent, which is less than
+    // N_MESSAGES only if an error occurred and NOTHROW is set.
+    size_t SendBatch(const UDPMessage* messages,
+                     size_t n_messages,
+                     bool nothrow = false) const;
+
+    size_t SendBatch(const std::vector<UDPMessage>& messages,
+                     bool nothrow = false) const {
+      return SendBatch(messages.empty() ? NULL : &messages[0],
+                       messages.size(), nothrow);
+    }
+
+    // Send the same datagram to every entry of DESTINATIONS. Return
+    // value as for SendBatch.
+    size_t SendToAll(const std::vector<UDPDestination>& destinations,
+                     const char* data,
+                     size_t length,
+                     bool nothrow = false) const;
+
+    // Serialize N_PACKETS packets and send them all to DESTINATION.
+    // Return value as for SendBatch.
+    size_t SendPackets(UDPPacket* const* packets,
+                       size_t n_packets,
+                       const UDPDestination& destination,
+                       bool nothrow = false) const;
 };
 
 #endif // UDPSERVER_HH__B7CA5A67_6C37_42DF_A4F5_9D21373080F8
@@ -0,0 +1,249 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 16:52:37 sb"
+
+/*
+  file       UDPStatistics.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <sbutil/UDPStatistics.hh>
+#include <sbutil/UDPClient.hh>
+#include <sbutil/Exception.hh>
+
+#include <limits>
+#include <sstream>
+#include <ctime>
+
+namespace
+{
+  // Single writer, so a plain load and store is enough and avoids the
+  // locked instructions of fetch_add.
+  inline void add(std::atomic<uint64_t>& a, uint64_t x){
+    if(x){
+      a.store(a.load(std::memory_order_relaxed) + x, std::memory_order_relaxed);
+    }
+  }
+
+  inline int64_t realtime_nanoseconds(){
+    struct timespec t;
+    clock_gettime(CLOCK_REALTIME, &t);
+    return static_cast<int64_t>(t.tv_sec) * 1000000000 + t.tv_nsec;
+  }
+}
+
+UDPStatisticsSnapshot::UDPStatisticsSnapshot()
+  : Representable(),
+    packets(0),
+    bytes(0),
+    truncated(0),
+    kernel_drops(0),
+    sequence_gaps(0),
+    sequence_lost(0),
+    sequence_late(0),
+    latency_count(0),
+    latency_sum(0),
+    latency_min(0),
+    latency_max(0)
+{}
+
+double UDPStatisticsSnapshot::GetMeanLatency() const {
+  return latency_count ? 1e-9 * latency_sum / latency_count : 0.0;
+}
+
+std::ostream& UDPStatisticsSnapshot::Represent(std::ostream& out) const {
+  out << packets << " packets, " << bytes << " bytes";
+  if(truncated){
+    out << ", " << truncated << " truncated";
+  }
+  out << ", " << kernel_drops << " dropped by kernel";
+  out << ", " << sequence_lost << " lost in " << sequence_gaps << " gaps, "
+      << sequence_late << " late";
+  if(latency_count){
+    out << ", latency " << 1e-3 * latency_min << " / "
+        << 1e6 * GetMeanLatency() << " / "
+        << 1e-3 * latency_max << " us (min / mean / max)";
+  }
+  return out;
+}
+
+UDPStatistics::UDPStatistics()
+  : packets(0),
+    bytes(0),
+    truncated(0),
+    kernel_drops(0),
+    sequence_gaps(0),
+    sequence_lost(0),
+    sequence_late(0),
+    latency_count(0),
+    latency_sum(0),
+    latency_min(0),
+    latency_max(0),
+    sequence_offset(0),
+    sequence_bytes(0),
+    sequence_mask(~(uint64_t)0),
+    next_sequence(0),
+    have_sequence(false),
+    drop_counter_last(0)
+{}
+
+void UDPStatistics::SetSequenceField(size_t offset, size_t bytes_){
+  if(bytes_ != 0 && bytes_ != 1 && bytes_ != 2 && bytes_ != 4 && bytes_ != 8){
+    std::ostringstream os;
+    os << "Sequence numbers of " << bytes_ << " bytes are not supported.";
+    throw EXCEPTION(os.str());
+  }
+  sequence_offset = offset;
+  sequence_bytes = bytes_;
+  sequence_mask = (bytes_ == 0 || bytes_ == 8) ?
+    ~(uint64_t)0 : (((uint64_t)1 << (8 * bytes_)) - 1);
+  have_sequence = false;
+}
+
+void UDPStatistics::AddSequence(uint64_t s){
+  const uint64_t mask = sequence_mask;
+  s &= mask;
+  if(!have_sequence){
+    have_sequence = true;
+    next_sequence = s;
+  }
+  // Distance ahead of the expected number, modulo the counter width.
+  // Anything more than half the range ahead is taken to be behind.
+  const uint64_t ahead = (s - next_sequence) & mask;
+  if(ahead == 0){
+    next_sequence = (s + 1) & mask;
+  }
+  else if(ahead <= (mask >> 1)){
+    add(sequence_gaps, 1);
+    add(sequence_lost, ahead);
+    next_sequence = (s + 1) & mask;
+  }
+  else{
+    add(sequence_late, 1);
+  }
+}
+
+void UDPStatistics::ReadSequence(const uint8_t* data, size_t length){
+  if(sequence_bytes == 0 || sequence_offset + sequence_bytes > length){
+    return;
+  }
+  uint64_t s = 0;
+  for(size_t k=0; k<sequence_bytes; ++k){
+    s = (s << 8) | data[sequence_offset + k];
+  }
+  AddSequence(s);
+}
+
+void UDPStatistics::AddLatency(uint64_t& count, uint64_t& sum,
+                               uint64_t& lo, uint64_t& hi,
+                               int64_t now, int64_t kernel_timestamp) const
+{
+  if(kernel_timestamp == 0){
+    return;
+  }
+  // Clamp to zero if the clock was stepped in between.
+  const uint64_t dt = now > kernel_timestamp ? now - kernel_timestamp : 0;
+  ++count;
+  sum += dt;
+  if(dt < lo){
+    lo = dt;
+  }
+  if(dt > hi){
+    hi = dt;
+  }
+}
+
+void UDPStatistics::Publish(uint64_t n_packets, uint64_t n_bytes, uint64_t n_truncated,
+                            uint32_t kernel_drop_counter,
+                            uint64_t n_latency, uint64_t sum, uint64_t lo, uint64_t hi)
+{
+  add(packets, n_packets);
+  add(bytes, n_bytes);
+  add(truncated, n_truncated);
+  // The kernel reports a running total for the socket, which is only
+  // sent along once it is nonzero. Count the difference modulo 2^32.
+  if(kernel_drop_counter != 0){
+    add(kernel_drops, (uint32_t)(kernel_drop_counter - drop_counter_last));
+    drop_counter_last = kernel_drop_counter;
+  }
+  if(n_latency){
+    const uint64_t c = latency_count.load(std::memory_order_relaxed);
+    if(c == 0 || lo < latency_min.load(std::memory_order_relaxed)){
+      latency_min.store(lo, std::memory_order_relaxed);
+    }
+    if(hi > latency_max.load(std::memory_order_relaxed)){
+      latency_max.store(hi, std::memory_order_relaxed);
+    }
+    add(latency_sum, sum);
+    add(latency_count, n_latency);
+  }
+}
+
+void UDPStatistics::AddBatch(const UDPReceiveBatch& batch){
+  const int64_t now = realtime_nanoseconds();
+  uint64_t n_bytes = 0;
+  uint64_t n_truncated = 0;
+  uint64_t n_latency = 0;
+  uint64_t sum = 0;
+  uint64_t lo = std::numeric_limits<uint64_t>::max();
+  uint64_t hi = 0;
+  for(size_t i=0; i<batch.GetSize(); ++i){
+    const size_t length = batch.GetLength(i);
+    n_bytes += length;
+    n_truncated += batch.IsTruncated(i);
+    AddLatency(n_latency, sum, lo, hi, now, batch.GetKernelTimestamp(i));
+    ReadSequence(batch.GetData(i), length);
+  }
+  Publish(batch.GetSize(), n_bytes, n_truncated, batch.GetKernelDropCounter(),
+          n_latency, sum, lo, hi);
+}
+
+void UDPStatistics::AddPacket(const uint8_t* data, size_t length,
+                              bool was_truncated,
+                              int64_t kernel_timestamp,
+                              uint32_t kernel_drop_counter)
+{
+  uint64_t n_latency = 0;
+  uint64_t sum = 0;
+  uint64_t lo = std::numeric_limits<uint64_t>::max();
+  uint64_t hi = 0;
+  if(kernel_timestamp){
+    AddLatency(n_latency, sum, lo, hi, realtime_nanoseconds(), kernel_timestamp);
+  }
+  ReadSequence(data, length);
+  Publish(1, length, was_truncated ? 1 : 0, kernel_drop_counter,
+          n_latency, sum, lo, hi);
+}
+
+UDPStatisticsSnapshot UDPStatistics::GetSnapshot() const {
+  UDPStatisticsSnapshot s;
+  s.packets = packets.load(std::memory_order_relaxed);
+  s.bytes = bytes.load(std::memory_order_relaxed);
+  s.truncated = truncated.load(std::memory_order_relaxed);
+  s.kernel_drops = kernel_drops.load(std::memory_order_relaxed);
+  s.sequence_gaps = sequence_gaps.load(std::memory_order_relaxed);
+  s.sequence_lost = sequence_lost.load(std::memory_order_relaxed);
+  s.sequence_late = sequence_late.load(std::memory_order_relaxed);
+  s.latency_count = latency_count.load(std::memory_order_relaxed);
+  s.latency_sum = latency_sum.load(std::memory_order_relaxed);
+  s.latency_min = latency_min.load(std::memory_order_relaxed);
+  s.latency_max = latency_max.load(std::memory_order_relaxed);
+  return s;
+}
+
+void UDPStatistics::Reset(){
+  packets = 0;
+  bytes = 0;
+  truncated = 0;
+  kernel_drops = 0;
+  sequence_gaps = 0;
+  sequence_lost = 0;
+  sequence_late = 0;
+  latency_count = 0;
+  latency_sum = 0;
+  latency_min = 0;
+  latency_max = 0;
+  have_sequence = false;
+}
+
+// UDPStatistics.cc ends here
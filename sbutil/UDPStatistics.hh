@@ -0,0 +1,131 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 16:52:37 sb"
+
+/*
+  file       UDPStatistics.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Receive statistics for a UDPClient: datagrams and bytes received,
+  datagrams the kernel dropped because the socket buffer was full,
+  gaps and late arrivals in a sequence number carried by the payload,
+  and the time between kernel receive and pickup by the application.
+
+  Attach with UDPClient::SetStatistics. The client then updates the
+  counters on every successful receive. Kernel drops and latency need
+  UDPClient::EnableKernelDropCounter and
+  UDPClient::EnableKernelTimestamps, respectively (Linux only). The
+  kernel reports drops along with the next datagram it queues, so the
+  drop count lags behind until the stream resumes. Drops are summed
+  over reopened sockets and wrap-around of the kernel's 32-bit
+  counter.
+
+  The counters are written by the one thread that receives on the
+  client, without read-modify-write instructions, and can be read at
+  any time from other threads with GetSnapshot(). Each counter in a
+  snapshot is exact, but they are read one after the other and may
+  be a few datagrams apart.
+
+  Needs to be compiled with -std=c++11.
+
+*/
+
+
+#ifndef UDPSTATISTICS_HH__C2018BE3_D78A_4195_A1F3_3F2817A3AF65
+#define UDPSTATISTICS_HH__C2018BE3_D78A_4195_A1F3_3F2817A3AF65
+
+#include <sbutil/Representable.hh>
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+class UDPReceiveBatch;
+
+struct UDPStatisticsSnapshot : public Representable {
+    uint64_t packets;
+    uint64_t bytes;
+    uint64_t truncated;       // datagrams longer than the receive buffer
+    uint64_t kernel_drops;    // reported by SO_RXQ_OVFL
+    uint64_t sequence_gaps;   // jumps ahead in the sequence number
+    uint64_t sequence_lost;   // sequence numbers skipped by the jumps
+    uint64_t sequence_late;   // reordered or duplicated datagrams
+    uint64_t latency_count;   // datagrams with a kernel timestamp
+    uint64_t latency_sum;     // nanoseconds
+    uint64_t latency_min;
+    uint64_t latency_max;
+
+    UDPStatisticsSnapshot();
+
+    // Mean latency in seconds, 0 if there were no kernel timestamps.
+    double GetMeanLatency() const;
+
+    std::ostream& Represent(std::ostream& out) const;
+};
+
+class UDPStatistics {
+  private:
+    std::atomic<uint64_t> packets;
+    std::atomic<uint64_t> bytes;
+    std::atomic<uint64_t> truncated;
+    std::atomic<uint64_t> kernel_drops;
+    std::atomic<uint64_t> sequence_gaps;
+    std::atomic<uint64_t> sequence_lost;
+    std::atomic<uint64_t> sequence_late;
+    std::atomic<uint64_t> latency_count;
+    std::atomic<uint64_t> latency_sum;
+    std::atomic<uint64_t> latency_min;
+    std::atomic<uint64_t> latency_max;
+
+    // Receiving thread only.
+    size_t sequence_offset;
+    size_t sequence_bytes;
+    uint64_t sequence_mask;
+    uint64_t next_sequence;
+    bool have_sequence;
+    uint32_t drop_counter_last;
+
+    // make non-copyable
+    UDPStatistics(const UDPStatistics&);
+    UDPStatistics& operator=(const UDPStatistics&);
+
+  public:
+    UDPStatistics();
+
+    // Read a big-endian unsigned sequence number of BYTES (1, 2, 4, or
+    // 8) bytes at OFFSET from every received payload. Wrap-around of
+    // narrow counters is handled. BYTES = 0 turns this off (default).
+    void SetSequenceField(size_t offset, size_t bytes);
+
+    // Receiving thread only, called by UDPClient. AddPacket and
+    // AddSequence can also be used directly if datagrams are received
+    // by other means, or the sequence number needs decoding.
+    void AddBatch(const UDPReceiveBatch& batch);
+    void AddPacket(const uint8_t* data, size_t length,
+                   bool was_truncated = false,
+                   int64_t kernel_timestamp = 0,
+                   uint32_t kernel_drop_counter = 0);
+    void AddSequence(uint64_t sequence);
+
+    // Any thread.
+    UDPStatisticsSnapshot GetSnapshot() const;
+
+    // Receiving thread only, or while nothing is received.
+    void Reset();
+
+    // Start tracking the kernel drop counter of a new socket, which
+    // counts from zero. Called by UDPClient::OpenSocket.
+    void ResetKernelDropCounter() {drop_counter_last = 0;}
+
+  private:
+    void ReadSequence(const uint8_t* data, size_t length);
+    void AddLatency(uint64_t& count, uint64_t& sum,
+                    uint64_t& lo, uint64_t& hi,
+                    int64_t now, int64_t kernel_timestamp) const;
+    void Publish(uint64_t n_packets, uint64_t n_bytes, uint64_t n_truncated,
+                 uint32_t kernel_drop_counter,
+                 uint64_t n_latency, uint64_t sum, uint64_t lo, uint64_t hi);
+};
+
+#endif // UDPSTATISTICS_HH__C2018BE3_D78A_4195_A1F3_3F2817A3AF65
+
+// UDPStatistics.hh ends here